@@ -0,0 +1,97 @@
+/*
+ * Animation.c
+ *
+ * See Animation.h.
+ */
+#include <avr/pgmspace.h>
+#include <stddef.h>
+#include "Animation.h"
+
+#define FRAMES(ms)		((ms) * 1000UL / ANIMATION_FRAME_US)
+
+#define SEG_LEFT		0x30	// e, f
+#define SEG_RIGHT		0x06	// b, c
+#define SEG_DASH		0x40	// g
+#define SEG_ALL			0xFF	// 8 and the dot
+
+static const animation_frame AnimationWork[] PROGMEM = {
+	{ { 0, 0, 0, SEG_LEFT  }, FRAMES(40) },
+	{ { 0, 0, 0, SEG_RIGHT }, FRAMES(40) },
+	{ { 0, 0, SEG_LEFT,  0 }, FRAMES(40) },
+	{ { 0, 0, SEG_RIGHT, 0 }, FRAMES(40) },
+	{ { 0, SEG_LEFT,  0, 0 }, FRAMES(40) },
+	{ { 0, SEG_RIGHT, 0, 0 }, FRAMES(40) },
+	{ { SEG_LEFT,  0, 0, 0 }, FRAMES(40) },
+	{ { SEG_RIGHT, 0, 0, 0 }, FRAMES(40) },
+	{ { 0, 0, 0, 0 }, 0 }
+};
+
+static const animation_frame AnimationPause[] PROGMEM = {
+	{ { SEG_DASH, SEG_DASH, SEG_DASH, SEG_DASH }, FRAMES(120) },
+	{ { 0, 0, 0, 0 }, FRAMES(80) },
+	{ { SEG_DASH, SEG_DASH, SEG_DASH, SEG_DASH }, FRAMES(120) },
+	{ { 0, 0, 0, 0 }, FRAMES(80) },
+	{ { SEG_DASH, SEG_DASH, SEG_DASH, SEG_DASH }, FRAMES(120) },
+	{ { 0, 0, 0, 0 }, FRAMES(80) },
+	{ { 0, 0, 0, 0 }, 0 }
+};
+
+static const animation_frame AnimationFinish[] PROGMEM = {
+	{ { SEG_ALL, SEG_ALL, SEG_ALL, SEG_ALL }, FRAMES(150) },
+	{ { 0, 0, 0, 0 }, FRAMES(100) },
+	{ { SEG_ALL, SEG_ALL, SEG_ALL, SEG_ALL }, FRAMES(150) },
+	{ { 0, 0, 0, 0 }, FRAMES(100) },
+	{ { SEG_ALL, SEG_ALL, SEG_ALL, SEG_ALL }, FRAMES(150) },
+	{ { 0, 0, 0, 0 }, FRAMES(100) },
+	{ { 0, 0, 0, 0 }, 0 }
+};
+
+// Next frame to load, NULL when idle
+static const animation_frame *Frame = NULL;
+static uint8_t Hold = 0;
+static uint8_t Segments[ANIMATION_DIGITS];
+
+void animationPlay(animation a) {
+	switch (a)
+	{
+		case ANIMATION_WORK:
+			Frame = AnimationWork;
+			break;
+		case ANIMATION_PAUSE:
+			Frame = AnimationPause;
+			break;
+		case ANIMATION_FINISH:
+			Frame = AnimationFinish;
+			break;
+		default:
+			Frame = NULL;
+			break;
+	}
+	Hold = 0;
+}
+
+// Once per display frame, before the digits are shown
+void animationFrame(void) {
+	uint8_t digit;
+
+	if (Frame == NULL) return;
+	if (Hold > 0) {
+		Hold--;
+		return;
+	}
+
+	Hold = pgm_read_byte(&Frame->Frames);
+	if (Hold == 0) {
+		Frame = NULL;
+		return;
+	}
+	for (digit = 0; digit < ANIMATION_DIGITS; digit++) Segments[digit] = pgm_read_byte(&Frame->Segments[digit]);
+	Frame++;
+	Hold--;
+}
+
+bool animationSegments(uint8_t digit, uint8_t *segments) {
+	if (Frame == NULL || digit >= ANIMATION_DIGITS) return false;
+	*segments = Segments[digit];
+	return true;
+}
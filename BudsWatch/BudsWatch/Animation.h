@@ -0,0 +1,36 @@
+/*
+ * Animation.h
+ *
+ * Short segment animations at phase changes. The frames are precomputed in
+ * flash and stepped by the display task once per display frame, so starting
+ * one is all the control task does, and the seconds tick never waits on it.
+ * While an animation plays it replaces DIGIT0..DIGIT3.
+ */
+#ifndef ANIMATION_H_
+#define ANIMATION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "BudsWatch.h"
+#include "Scheduler.h"
+
+#define ANIMATION_DIGITS	4
+#define ANIMATION_FRAME_US	((uint32_t)DISPLAY_FRAME * SCHED_TICK_US)
+
+typedef enum {
+	ANIMATION_NONE,
+	ANIMATION_WORK,		// Bar sweeping left to right
+	ANIMATION_PAUSE,	// Flashing dashes
+	ANIMATION_FINISH	// Flashing 8s
+} animation;
+
+typedef struct {
+	uint8_t Segments[ANIMATION_DIGITS];	// Segment patterns, DIGIT0 first
+	uint8_t Frames;						// Display frames to show it, 0 ends
+} animation_frame;
+
+void animationPlay(animation a);
+void animationFrame(void);
+bool animationSegments(uint8_t digit, uint8_t *segments);
+
+#endif /* ANIMATION_H_ */
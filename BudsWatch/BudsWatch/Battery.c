@@ -0,0 +1,102 @@
+/*
+ * Battery.c
+ *
+ * See Battery.h.
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+#include <stdbool.h>
+#include "Battery.h"
+
+#define BATTERY_MUX_BANDGAP		((1 << MUX4) | (1 << MUX3) | (1 << MUX2) | (1 << MUX1))
+
+static const power_profile Profiles[] = {
+	[BATTERY_OK]       = { DISPLAY_UNITS,     DISPLAY_UNITS,     false },
+	[BATTERY_LOW]      = { DISPLAY_UNITS / 2, DISPLAY_UNITS / 2, true },
+	[BATTERY_CRITICAL] = { DISPLAY_UNITS / 4, DISPLAY_UNITS / 4, true }
+};
+
+static volatile bool AdcDone = false;
+static uint16_t Samples[BATTERY_FILTER_LENGTH];
+static uint16_t SampleSum = 0;
+static uint8_t SampleIndex = 0;
+static battery_level Level = BATTERY_OK;
+
+static void batteryFilter(uint16_t sample);
+static void batteryClassify(void);
+
+void batteryInit(void) {
+	uint8_t i;
+
+	ADMUX = (1 << REFS0) | BATTERY_MUX_BANDGAP;          // AVCC reference, measure VBG
+	ADCSRA = (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1);  // Fcpu/64 = 125kHz
+
+	// Seed the filter with polled conversions, before interrupts are enabled
+	ADCSRA |= (1 << ADEN);
+	for (i = 0; i < BATTERY_FILTER_LENGTH; i++) {
+		ADCSRA |= (1 << ADSC);
+		while (ADCSRA & (1 << ADSC));
+		Samples[i] = ADC;
+		SampleSum += Samples[i];
+	}
+	ADCSRA &= ~(1 << ADEN);
+	ADCSRA |= (1 << ADIF);                               // Clear pending interrupt
+	batteryClassify();
+}
+
+/*
+ * Call right after a seconds tick, so the Timer 1 correction cannot step
+ * past the compare value.
+ */
+void batterySample(void) {
+	AdcDone = false;
+	ADCSRA |= (1 << ADEN);
+	set_sleep_mode(SLEEP_MODE_ADC);
+
+	// Entering the sleep mode starts the conversion. Other wake-ups go back to sleep.
+	cli();
+	while (!AdcDone) {
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+		cli();
+	}
+	TCNT1 += BATTERY_SLEEP_TICKS;
+	sei();
+
+	ADCSRA &= ~(1 << ADEN);
+	batteryFilter(ADC);
+}
+
+battery_level batteryLevel(void) {
+	return Level;
+}
+
+const power_profile *batteryProfile(void) {
+	return &Profiles[Level];
+}
+
+static void batteryFilter(uint16_t sample) {
+	SampleSum -= Samples[SampleIndex];
+	Samples[SampleIndex] = sample;
+	SampleSum += sample;
+	if (++SampleIndex >= BATTERY_FILTER_LENGTH) SampleIndex = 0;
+	batteryClassify();
+}
+
+static void batteryClassify(void) {
+	uint16_t average;
+
+	// A lower supply gives a higher bandgap reading
+	average = SampleSum >> BATTERY_FILTER_SHIFT;
+	if (average >= BATTERY_COUNTS(BATTERY_CRITICAL_MV)) Level = BATTERY_CRITICAL;
+	else if (average >= BATTERY_COUNTS(BATTERY_LOW_MV)) Level = BATTERY_LOW;
+	else Level = BATTERY_OK;
+}
+
+ISR(ADC_vect) {
+	AdcDone = true;
+}
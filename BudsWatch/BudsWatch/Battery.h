@@ -0,0 +1,51 @@
+/*
+ * Battery.h
+ *
+ * Supply monitoring. The ADC measures the internal bandgap against AVCC,
+ * so no pin is needed: Vcc = VBG * 1024 / ADC. Conversions run in ADC noise
+ * reduction sleep and are smoothed with a moving average.
+ */
+#ifndef BATTERY_H_
+#define BATTERY_H_
+
+#include <stdint.h>
+#include "BudsWatch.h"
+
+#define BATTERY_BANDGAP_MV		1230
+#define BATTERY_LOW_MV			4000	// Board dependent
+#define BATTERY_CRITICAL_MV		3600
+#define BATTERY_COUNTS(mv)		((uint16_t)(BATTERY_BANDGAP_MV * 1024UL / (mv)))
+
+#define BATTERY_SAMPLE_PERIOD	8		// Seconds between samples
+#define BATTERY_FILTER_SHIFT	3		// Average of 8 samples
+#define BATTERY_FILTER_LENGTH	(1 << BATTERY_FILTER_SHIFT)
+
+/*
+ * Timer 1 stops in ADC noise reduction sleep. The first conversion after
+ * enabling the ADC takes 25 ADC clocks at Fcpu/64, i.e. 6.25 Timer 1 counts
+ * at Fcpu/256, which are added back after waking.
+ *
+ * Timers 0 and 2 stop as well and are not corrected: the scheduler tick and
+ * debouncing fall ~200us behind once per sample. The caller samples between
+ * display frames with the display dark, so no digit is lit for longer.
+ */
+#define BATTERY_SLEEP_TICKS		6
+
+typedef enum {
+	BATTERY_OK,
+	BATTERY_LOW,
+	BATTERY_CRITICAL
+} battery_level;
+
+typedef struct {
+	uint8_t Brightness;		// Lit units per display slot
+	uint8_t Volume;			// Buzzer units per display slot
+	uint8_t Warning;		// Flash the low battery glyph
+} power_profile;
+
+void batteryInit(void);
+void batterySample(void);
+battery_level batteryLevel(void);
+const power_profile *batteryProfile(void);
+
+#endif /* BATTERY_H_ */
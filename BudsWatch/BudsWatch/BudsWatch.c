@@ -6,29 +6,41 @@
  */ 
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <util/delay.h>
+#include <util/atomic.h>
 #include <stdbool.h>
+#include "BudsWatch.h"
+#include "HistoryLog.h"
+#include "Battery.h"
+#include "StateMachine.h"
+#include "Animation.h"
+#include "Scheduler.h"
+#ifdef TWI_SLAVE
+#include "TwiSlave.h"
+#endif
+#ifdef DISPLAY_SHIFT_REGISTER
+#include "ShiftDisplay.h"
+#endif
 
-#define F_CPU 8000000UL // 8Mhz Crystal Oscillator
-
-#define PRECOUNT			10
 #define BUZZER_LONG			200
 #define BUZZER_SHORT		100  // x~2ms = ~100ms
-#define DEFAULT_BUZZCOUNT	4
 #define BUZZ_PORT			PORTC
 #define BUZZ_SHORT_MASK		(1 << PC5)
 #define BUZZ_LONG_MASK		(1 << PC4)
 
-#define DIGIT0				0
-#define DIGIT1				1
-#define DIGIT2				2
-#define DIGIT3				3
+#define DIGIT_WARNING		(DISPLAY_DIGITS - 1)
+
+#define GLYPH_LOW_BATTERY	0x38 // L
 
-#define DIGIT_B				10
-#define DIGIT_U				11
-#define DIGIT_D				12
-#define DIGIT_S				13
+#ifdef TWI_SLAVE // PC0/PC1 are SCL/SDA
+#define KEY0_MASK			(1 << PD4)
+#define KEY1_MASK			(1 << PD5)
+#define KEY2_MASK			(1 << PD6)
+#define KEY3_MASK			(1 << PD7)
 
+#define KEY_PIN				PIND
+#define KEY_PORT			PORTD
+#define KEY_DDR				DDRD
+#else
 #define KEY0_MASK			(1 << PC0)
 #define KEY1_MASK			(1 << PC1)
 #define KEY2_MASK			(1 << PC2)
@@ -37,94 +49,69 @@
 #define KEY_PIN				PINC
 #define KEY_PORT			PORTC
 #define KEY_DDR				DDRC
+#endif
 
-// Define enums
-typedef enum {
-	STATE_SELECT,
-	STATE_CONFIGURE,
-	STATE_PRECOUNT,
-	STATE_RUNNING,
-	STATE_FINISHED
-} state;
-
-typedef enum {
-	MODE_STOPWATCH = 1,	// Stopwatch: Count from 0
-	MODE_TIMER = 2,     // Count down from selected time
-	MODE_INTERVAL = 3,  // x sec work, y sec pause, z rounds
-	MODE_TABATA = 4,    // 20 sec work, 10 sec pause, 8 rounds
-	MODE_FGB = 5,
-	MODE_LAST = MODE_FGB
-} mode;
-
-typedef enum {
-	CONF_WORK_MINUTES,
-	CONF_WORK_SECONDS,
-	CONF_REST_MINUTES,
-	CONF_REST_SECONDS,
-	CONF_ROUNDS,
-	CONF_LAST = CONF_ROUNDS
-} interval_configure;
-
-// Define structs
-typedef struct {
-	uint8_t Minutes;
-	uint8_t Seconds;
-} clock;
-
-typedef struct {
-	uint8_t digits[4];
-	uint8_t showdigits;
-	uint8_t dots;
-} seven_segment_state;
-
-typedef struct {
-	clock Work;
-	clock Pause;
-	uint8_t RoundsWork;
-	uint8_t RoundsPause;
-} interval_timer;
+#define KEY_ALL_MASK		(KEY0_MASK | KEY1_MASK | KEY2_MASK | KEY3_MASK)
+#define KEY_HOLD_PRESCALE	10   // x~33ms x 3 steps = ~1s hold
+#define KEY_ABORT_CHORD		(KEY1_MASK | KEY2_MASK)
 
 // Global variables
-seven_segment_state ssState;
 
 volatile uint8_t SecondElapsed  = false;
 volatile uint8_t TickCounter = 0;
 static volatile uint8_t Buzzer = 0;
-static volatile uint8_t BuzzCount = 0;
 static volatile uint8_t key_press;
+static volatile uint8_t key_hold;
+static volatile uint8_t key_chord;
+static volatile bool BatterySampleDue = false;
+static volatile bool BatteryBlink = false;
+static uint8_t BuzzOutput = 0;
+
+static state_machine Machine;
+static history_entry HistoryPending;
+static bool HistoryWaiting = false;
+static uint8_t BuzzMask    = 0;
 
 // Function prototypes
-extern double floor(double x);
 uint8_t digitToSevenSegment(uint8_t digit);
+uint8_t digitPattern(uint8_t digit);
 void showDigit(uint8_t digit, uint8_t port);
+void showDisplay(void);
+void taskControl(void);
+void taskDisplay(void);
+void taskAudio(void);
+void taskBattery(void);
 bool detectKeypress(uint8_t mask);
+bool detectHold(uint8_t mask);
+bool detectChord(uint8_t mask);
 void UpdateBuzzer();
 
+/*
+ * Display and audio run every tick, so their periods hold whatever the rest
+ * costs. Tasks due in the same tick run in table order, so the battery task
+ * runs just before the display starts a frame.
+ */
+static sched_task Tasks[] = {
+	{ .Run = taskBattery, .Period = DISPLAY_FRAME,     .Offset = 0,                .Budget = SCHED_US(400) },
+	{ .Run = taskDisplay, .Period = 1,                 .Offset = 0,                .Budget = SCHED_US(60) },
+	{ .Run = taskAudio,   .Period = 1,                 .Offset = 0,                .Budget = SCHED_US(20) },
+	{ .Run = taskControl, .Period = SCHED_TICKS(10),   .Offset = 1,                .Budget = SCHED_US(400) }
+};
+
 int main (void) 
 { 
-	clock clockState;
-	interval_timer intervalState;
-	interval_configure intervalConfiguration = CONF_WORK_MINUTES;
-
-	mode Mode           = MODE_STOPWATCH;
-	state State			= STATE_SELECT;
-	uint8_t PreCount    = PRECOUNT;
-	uint8_t BuzzCount   = 0;
-	bool Interval       = false;
-	uint8_t Minutes     = 0; // Configure
-	uint8_t Seconds     = 0; // Configure
-	uint8_t	BuzzMask	= 0;
-	
 	/* SET UP I/O */
+#ifdef DISPLAY_SHIFT_REGISTER
+	shiftDisplayInit();
+#else
 	DDRA = 0xFF;		                   // Enable all port A LEDs
 	DDRB = (1 << PB0) 
 		 | (1 << PB1) 
 		 | (1 << PB2) 
 		 | (1 << PB3);                     // Enable 4 7 segment displays
+#endif
 	DDRC = BUZZ_SHORT_MASK | BUZZ_LONG_MASK;
-	KEY_PORT = KEY2_MASK | 
-			   KEY1_MASK | 
-			   KEY0_MASK;	               // Pull-ups on
+	KEY_PORT = KEY_ALL_MASK;	           // Pull-ups on
 
 	/* SET UP TIMERS */
 	// Timer 0: Debouncing 2ms
@@ -138,369 +125,232 @@ int main (void)
 
 	TIMSK |= (1 << OCIE1A) | (1 << TOIE0); // Output Compare Interrup Enable on timer 1 channel A and timer 0
 	
+	// Timer 2: Scheduler tick
+	schedInit();
+	
+	machineInit(&Machine);
+	historyInit();
+	batteryInit();
+#ifdef TWI_SLAVE
+	twiInit();
+#endif
+	
 	sei();
-	for (;;) 
-	{ 
-		switch (State)
-		{
-		    case STATE_SELECT:
-				if (detectKeypress(KEY0_MASK))
-				{					
-					switch (Mode)
-					{
-					    case MODE_STOPWATCH:
-							clockState.Minutes          = 0;
-							clockState.Seconds          = 0;
-							Interval = false;
-							State = STATE_PRECOUNT;
-							break;
-						case MODE_TIMER:
-							clockState.Minutes			= 0;
-							clockState.Seconds			= 0;
-							intervalState.Work.Minutes  = 1;
-							intervalState.Work.Seconds  = 0;
-							intervalState.Pause.Minutes = 1;
-							intervalState.Pause.Seconds = 0;
-							intervalState.RoundsWork    = 1;
-							intervalState.RoundsPause   = 0;
-							Interval				    = true;
-							State = STATE_CONFIGURE;
-							break;
-						case MODE_INTERVAL:
-							clockState.Minutes			= 0;
-							clockState.Seconds			= 0;
-							intervalState.Work.Minutes  = 1;
-							intervalState.Work.Seconds  = 0;
-							intervalState.Pause.Minutes = 1;
-							intervalState.Pause.Seconds = 0;
-							intervalState.RoundsWork    = 1;
-							intervalState.RoundsPause   = 0;							
-							Interval					= true;
-							State = STATE_CONFIGURE;
-							break;
-						case MODE_TABATA:
-							clockState.Minutes			= 0;
-							clockState.Seconds			= 0;
-							intervalState.Work.Minutes  = 0;
-							intervalState.Work.Seconds  = 20;
-							intervalState.Pause.Minutes = 0;
-							intervalState.Pause.Seconds = 10;
-							intervalState.RoundsWork    = 8;
-							intervalState.RoundsPause   = 8;							
-							Interval					= true;
-							State = STATE_PRECOUNT;
-							break;
-						case MODE_FGB:
-							clockState.Minutes			= 0;
-							clockState.Seconds			= 0;
-							intervalState.Work.Minutes  = 1;
-							intervalState.Work.Seconds  = 0;
-							intervalState.Pause.Minutes = 0;
-							intervalState.Pause.Seconds = 0;
-							intervalState.RoundsWork    = 18;
-							intervalState.RoundsPause   = 0;							
-							Interval					= true;
-							State = STATE_PRECOUNT;
-							break;
-						default:
-					        break;
-					}
-				}
-				if (detectKeypress(KEY1_MASK)) {
-					if (++Mode > MODE_LAST) Mode = MODE_STOPWATCH;
-				}
-				if (detectKeypress(KEY2_MASK)) {
-					if (--Mode < 1) Mode = MODE_LAST;
-				}
-			
-				ssState.showdigits = (1 << DIGIT0);
-				ssState.digits[DIGIT0] = Mode;
-				
-				if (SecondElapsed > 0) {
-					ssState.dots ^= (1 << DIGIT0);
-					SecondElapsed--;
-				}
-				break;
-			case STATE_CONFIGURE:
-				switch (Mode)
-				{
-					case MODE_TIMER:
-						if (detectKeypress(KEY0_MASK)) {
-							State = STATE_PRECOUNT;							
-						}
-						if (detectKeypress(KEY1_MASK)) {
-							if (intervalState.Work.Minutes >= 59) intervalState.Work.Minutes = 0;
-							else intervalState.Work.Minutes++;							
-						}
-						if (detectKeypress(KEY2_MASK)) {
-							if (intervalState.Work.Minutes == 0) intervalState.Work.Minutes = 59;
-							else intervalState.Work.Minutes--;
-						}
-						Minutes = intervalState.Work.Minutes;
-						Seconds = intervalState.Work.Seconds;
-						ssState.showdigits = (1 << DIGIT3) | (1 << DIGIT2);
-						break;
-					case MODE_INTERVAL:
-						switch (intervalConfiguration) {
-							case CONF_WORK_MINUTES:
-								if (detectKeypress(KEY0_MASK)) {
-									intervalConfiguration++;
-								}
-								if (detectKeypress(KEY1_MASK)) {
-									if (intervalState.Work.Minutes >= 59) intervalState.Work.Minutes = 0;
-									else intervalState.Work.Minutes++;
-								}
-								if (detectKeypress(KEY2_MASK)) {
-									if (intervalState.Work.Minutes == 0) intervalState.Work.Minutes = 59;
-									else intervalState.Work.Minutes--;
-								}
-								Minutes = intervalState.Work.Minutes;
-								Seconds = intervalState.Work.Seconds;
-								ssState.showdigits = (1 << DIGIT3) | (1 << DIGIT2);
-								break;
-							case CONF_WORK_SECONDS:
-								if (detectKeypress(KEY0_MASK)) {
-									intervalConfiguration++;
-								}
-								if (detectKeypress(KEY1_MASK)) {
-									if (intervalState.Work.Seconds >= 59) intervalState.Work.Seconds = 0;
-									else intervalState.Work.Seconds++;
-								}
-								if (detectKeypress(KEY2_MASK)) {
-									if (intervalState.Work.Seconds == 0) intervalState.Work.Seconds = 59;
-									else intervalState.Work.Seconds--;
-								}
-								Minutes = intervalState.Work.Minutes;
-								Seconds = intervalState.Work.Seconds;
-								ssState.showdigits = (1 << DIGIT0) | (1 << DIGIT1);
-								break;
-							case CONF_REST_MINUTES:
-								if (detectKeypress(KEY0_MASK)) {
-									intervalConfiguration++;
-								}
-								if (detectKeypress(KEY1_MASK)) {
-									if (intervalState.Pause.Minutes >= 59) intervalState.Pause.Minutes = 0;
-									else intervalState.Pause.Minutes++;
-								}
-								if (detectKeypress(KEY2_MASK)) {
-									if (intervalState.Pause.Minutes == 0) intervalState.Pause.Minutes = 59;
-									else intervalState.Pause.Minutes--;
-								}
-								Minutes = intervalState.Pause.Minutes;
-								Seconds = intervalState.Pause.Seconds;
-								ssState.showdigits = (1 << DIGIT3) | (1 << DIGIT2);
-								break;
-							case CONF_REST_SECONDS:
-								if (detectKeypress(KEY0_MASK)) {
-									intervalConfiguration++;
-								}
-								if (detectKeypress(KEY1_MASK)) {
-									if (intervalState.Pause.Seconds >= 59) intervalState.Pause.Seconds = 0;
-									else intervalState.Pause.Seconds++;
-								}
-								if (detectKeypress(KEY2_MASK)) {
-									if (intervalState.Pause.Seconds == 0) intervalState.Pause.Seconds = 59;
-									else intervalState.Pause.Seconds--;
-								}
-								Minutes = intervalState.Pause.Minutes;
-								Seconds = intervalState.Pause.Seconds;
-								ssState.showdigits = (1 << DIGIT0) | (1 << DIGIT1);
-								break;
-							case CONF_ROUNDS:
-								if (detectKeypress(KEY0_MASK)) {
-									State = STATE_PRECOUNT;
-								}
-								if (detectKeypress(KEY1_MASK)) {
-									if (intervalState.RoundsWork >= 99) {
-										intervalState.RoundsWork = 0;
-										intervalState.RoundsPause = 0;
-									} else {
-										intervalState.RoundsWork++;
-										if (intervalState.Pause.Minutes > 0 || intervalState.Pause.Seconds > 0) intervalState.RoundsPause++;
-									}										
-								}
-								if (detectKeypress(KEY2_MASK)) {
-									if (intervalState.RoundsWork == 0) {
-										intervalState.RoundsWork = 99;
-										if (intervalState.Pause.Minutes > 0 || intervalState.Pause.Seconds > 0) intervalState.RoundsPause = 99;
-									} else {
-										intervalState.RoundsWork--;
-										if (intervalState.Pause.Minutes > 0 || intervalState.Pause.Seconds > 0) intervalState.RoundsPause--;
-									}	
-								}
-								Minutes = intervalState.RoundsWork;
-								Seconds = intervalState.RoundsPause;
-								ssState.showdigits = (1 << DIGIT3) | (1 << DIGIT2) | (1 << DIGIT1) | (1 << DIGIT0);
-								
-								break;
-							default:
-								break;
-						}
-						break;
-				    default:
-				        ssState.showdigits = 0;
-				        break;
-				}
-				if (SecondElapsed > 0) SecondElapsed--;
-				ssState.digits[DIGIT3] = floor(Minutes / 10);
-				ssState.digits[DIGIT2] = Minutes % 10;
-				ssState.digits[DIGIT1] = floor(Seconds / 10);
-				ssState.digits[DIGIT0] = Seconds % 10;
-				ssState.dots = 0;
-				break;
-			case STATE_PRECOUNT:
-				if (SecondElapsed > 0) {
-					SecondElapsed--;
-					
-					ssState.digits[DIGIT1] = floor(PreCount / 10);
-					ssState.digits[DIGIT0] = PreCount % 10;
-					ssState.showdigits = (1 << DIGIT0) | (PreCount > 9 ? (1 << DIGIT1) : 0);
-					ssState.dots = (PreCount % 2 == 0 ? (1 << DIGIT0) : 0);
-					if (PreCount == DEFAULT_BUZZCOUNT-1) BuzzCount = DEFAULT_BUZZCOUNT;
-
-					if (BuzzCount > 1) {
-						Buzzer = BUZZER_SHORT;
-						BuzzMask = BUZZ_SHORT_MASK;
-						BuzzCount--;
-					}
-					else if (BuzzCount == 1) {
-						Buzzer = BUZZER_LONG;
-						BuzzMask = BUZZ_LONG_MASK;
-						BuzzCount--;
-					}
-
-					PreCount--;
-					if (PreCount == 0) State = STATE_RUNNING;
-				}
-				break;
-			case STATE_RUNNING:
-				if (SecondElapsed > 0) {
-					SecondElapsed--;
-					
-					if (BuzzCount > 1) {
-						Buzzer = BUZZER_SHORT;
-						BuzzMask = BUZZ_SHORT_MASK;
-						BuzzCount--;
-					}
-					else if (BuzzCount == 1) {
-						Buzzer = BUZZER_LONG;
-						BuzzMask = BUZZ_LONG_MASK;
-						BuzzCount--;
-					}
-					
-					if (Interval && clockState.Minutes == 0 && clockState.Seconds == 0)
-					{
-						if (intervalState.RoundsPause > intervalState.RoundsWork)
-						{
-							clockState.Minutes = intervalState.Pause.Minutes;
-							clockState.Seconds = intervalState.Pause.Seconds;
-							intervalState.RoundsPause--;
-						}
-						else if (intervalState.RoundsWork > 0)
-						{
-							clockState.Minutes = intervalState.Work.Minutes;
-							clockState.Seconds = intervalState.Work.Seconds;
-							intervalState.RoundsWork--;
-						}
-						else
-						{
-							// sleep?
-						}
-					}
-
-					ssState.showdigits = (1 << DIGIT0) | (1 << DIGIT1) | (1 << DIGIT2) | (1 << DIGIT3);
-					if (clockState.Seconds % 2 == 1) ssState.dots = (1 << DIGIT2);
-					else ssState.dots = 0;
-					
-					// BUDS
-					if (clockState.Minutes == 0 && clockState.Seconds == 0) {
-						ssState.digits[DIGIT3] = DIGIT_B;
-						ssState.digits[DIGIT2] = DIGIT_U;
-						ssState.digits[DIGIT1] = DIGIT_D;
-						ssState.digits[DIGIT0] = DIGIT_S;
-					} else {
-						if (Mode == MODE_TABATA) {
-							ssState.showdigits = (1 << DIGIT0) | (1 << DIGIT1) |  (1 << DIGIT3);
-							ssState.digits[DIGIT3] = intervalState.RoundsPause;
-							ssState.digits[DIGIT2] = 0;
-							ssState.digits[DIGIT1] = floor(clockState.Seconds / 10);
-							ssState.digits[DIGIT0] = clockState.Seconds % 10;	
-						} else {
-							ssState.digits[DIGIT3] = floor(clockState.Minutes / 10);
-							ssState.digits[DIGIT2] = clockState.Minutes % 10;
-							ssState.digits[DIGIT1] = floor(clockState.Seconds / 10);
-							ssState.digits[DIGIT0] = clockState.Seconds % 10;
-						}
-					}
-						
-					if (Interval) {
-						clockState.Seconds--;
-						if (clockState.Seconds >= 60) {
-							if (clockState.Minutes > 0) { 
-								clockState.Minutes--;
-								clockState.Seconds = 59;
-							} else {
-								clockState.Seconds = 0;
-							}						
-					
-						}
-						if (clockState.Minutes == 0 && clockState.Seconds == DEFAULT_BUZZCOUNT-1) {
-							BuzzCount = DEFAULT_BUZZCOUNT;
-						}
-					}
-					else
-					{
-						clockState.Seconds++;
-						if (clockState.Seconds >= 60) {
-							clockState.Seconds = 0;
-							clockState.Minutes++;
-							if (clockState.Minutes > 59) clockState.Minutes = 0;
-						}
-					}
-					
+	schedRun(Tasks, sizeof(Tasks) / sizeof(Tasks[0]));
+}
+
+// Samples between display frames, so the conversion sleep only stretches the dark gap
+void taskBattery(void) {
+	if (BatterySampleDue) {
+		BatterySampleDue = false;
+#ifdef DISPLAY_SHIFT_REGISTER
+		shiftDisplayEnable(false);
+#else
+		PORTA = 0xFF;
+#endif
+		batterySample();
+	}
+}
+
+// Keys, commands and the mode state machine
+void taskControl(void) {
+	machine_input input;
+	machine_output output;
+	state_machine *m = &Machine;
+
+	input.Presses = (detectKeypress(KEY0_MASK) ? MACHINE_KEY0 : 0)
+				  | (detectKeypress(KEY1_MASK) ? MACHINE_KEY1 : 0)
+				  | (detectKeypress(KEY2_MASK) ? MACHINE_KEY2 : 0)
+				  | (detectKeypress(KEY3_MASK) ? MACHINE_KEY3 : 0);
+	// Gestures: KEY1+KEY2 or holding KEY3 aborts to mode select
+	input.Abort = detectChord(KEY_ABORT_CHORD) | detectHold(KEY3_MASK);
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		input.Tick = SecondElapsed > 0;
+		if (input.Tick) SecondElapsed--;
+	}
+	input.Command = COMMAND_NONE;
+	input.Setup.Written = 0;
+
+#ifdef TWI_SLAVE
+	switch (twiCommand())
+	{
+		case TWI_COMMAND_START:
+			{
+				twi_registers setup;
+				uint16_t written = twiSetup(&setup);
+				uint8_t i;
+
+				if (written & (1U << TWI_REG_MODE)) input.Setup.Written |= SETUP_MODE;
+				for (i = 0; i < SETUP_CONFIG_FIELDS; i++) {
+					if (written & (1U << (TWI_REG_WORK_MINUTES + i))) input.Setup.Written |= SETUP_CONFIG(i);
 				}
-				break;
-			default:
-				// Do nothing
-				break;
-		}
-		
-		showDigit(DIGIT3, PB3);
-		showDigit(DIGIT2, PB2);
-		showDigit(DIGIT1, PB1);
-		showDigit(DIGIT0, PB0);
+				input.Setup.Mode = setup.Mode;
+				input.Setup.Config = setup.Config;
+				input.Command = COMMAND_START;
+			}
+			break;
+		case TWI_COMMAND_PAUSE:
+			input.Command = COMMAND_PAUSE;
+			break;
+		case TWI_COMMAND_RESET:
+			input.Command = COMMAND_RESET;
+			break;
+		default:
+			break;
+	}
+#endif
+	
+	machineStep(m, &input, &output);
+	
+	switch (output.Beep)
+	{
+		case BEEP_SHORT:
+			Buzzer = BUZZER_SHORT;
+			BuzzMask = BUZZ_SHORT_MASK;
+			break;
+		case BEEP_LONG:
+			Buzzer = BUZZER_LONG;
+			BuzzMask = BUZZ_LONG_MASK;
+			break;
+		case BEEP_SILENCE:
+			Buzzer = 0;
+			break;
+		default:
+			break;
+	}
+	switch (output.Phase)
+	{
+		case SEGMENT_WORK:
+			animationPlay(ANIMATION_WORK);
+			break;
+		case SEGMENT_PAUSE:
+			animationPlay(ANIMATION_PAUSE);
+			break;
+		case SEGMENT_END:
+			animationPlay(ANIMATION_FINISH);
+			break;
+		default:
+			break;
+	}
+	if (output.Ended == SESSION_ABORTED) animationPlay(ANIMATION_NONE);
+	if (output.Ended != SESSION_RUNNING) {
+		HistoryPending.Mode      = m->Mode;
+		HistoryPending.Config    = m->sessionState;
+		HistoryPending.Completed = output.Completed;
+		HistoryPending.Duration  = m->SessionSeconds;
+		HistoryPending.Aborted   = output.Ended == SESSION_ABORTED;
+		HistoryWaiting = true;
+	}
+	// Retried while a dump or the previous record keeps the log busy
+	if (HistoryWaiting) {
+		history_entry *e = &HistoryPending;
+		HistoryWaiting = !historyAppend(e->Mode, &e->Config, e->Completed, e->Duration, e->Aborted);
+	}
+	
+#ifdef TWI_SLAVE
+	{
+		twi_registers registers;
+		uint32_t remaining;
+
+		registers.Mode    = m->Mode;
+		registers.State   = m->State | (m->Paused ? TWI_STATE_PAUSED : 0);
+		registers.Minutes = m->clockState.Minutes;
+		registers.Seconds = m->clockState.Seconds;
+		registers.Round   = m->State == STATE_RUNNING ? timelineRound(&m->Timeline) : 0;
+		registers.Config  = m->State == STATE_RUNNING ? m->sessionState : m->intervalState;
+		registers.Command = 0;
+		registers.NextUp  = m->State == STATE_RUNNING && m->Interval ? timelineNext(&m->Timeline) : SEGMENT_NONE;
+		remaining         = m->State == STATE_RUNNING && m->Interval ? timelineRemaining(&m->Timeline) / 60 : 0;
+		registers.TotalMinutes = remaining > 255 ? 255 : remaining;
+		registers.TotalSeconds = m->State == STATE_RUNNING && m->Interval ? timelineRemaining(&m->Timeline) % 60 : 0;
+		registers.Overruns = schedOverruns();
+		registers.Slips    = schedSlips();
+		twiPublish(&registers);
+	}
+#endif
+	
+	if (Buzzer > 0)
+	{
+		BuzzOutput = BuzzMask;
+	}
+	else
+	{
+		BuzzOutput = 0;
+		BUZZ_PORT &= ~(BUZZ_SHORT_MASK | BUZZ_LONG_MASK);
+	}
+}
+
+/*
+ * Each digit gets a slot of DISPLAY_UNITS ticks, and the power profile
+ * decides how many of them the segments are lit for. Animations step once
+ * per frame of DISPLAY_SLOTS slots.
+ */
+void taskDisplay(void) {
+	static uint8_t slot = 0;
+	static uint8_t unit = 0;
+
+	if (unit == 0) {
+		if (slot == 0) animationFrame();
+#ifdef DISPLAY_SHIFT_REGISTER
+		// The registers hold the frame, so the slots only pace dimming
+		if (slot == 0) showDisplay();
+		shiftDisplayEnable(true);
+#else
+		showDigit(DIGIT3 - slot, PB3 - slot);
+#endif
+	}
+	if (unit == batteryProfile()->Brightness) {
+#ifdef DISPLAY_SHIFT_REGISTER
+		shiftDisplayEnable(false);
+#else
 		PORTA = 0xFF;
-		PORTB = 0;
-		
-		if (Buzzer > 0)
-		{
-			BUZZ_PORT |= BuzzMask;
-		}
-		else
-		{
-			BUZZ_PORT &= ~(BUZZ_SHORT_MASK | BUZZ_LONG_MASK);
-		}
-	} 
+#endif
+	}
+	if (++unit >= DISPLAY_UNITS) {
+		unit = 0;
+		if (++slot >= DISPLAY_SLOTS) slot = 0;
+	}
+}
+
+// Gates the buzzer in step with the display slots for the volume setting
+void taskAudio(void) {
+	static uint8_t unit = 0;
+
+	if (unit == 0) BUZZ_PORT |= BuzzOutput;
+	if (unit == batteryProfile()->Volume) BUZZ_PORT &= ~(BUZZ_SHORT_MASK | BUZZ_LONG_MASK);
+	if (++unit >= DISPLAY_UNITS) unit = 0;
 }
 
 // Timer 1 interrupt (1 sec)
 ISR(TIMER1_COMPA_vect) {
+	static uint8_t BatteryCountdown = BATTERY_SAMPLE_PERIOD;
+
 	SecondElapsed++;
+	BatteryBlink = !BatteryBlink;
+	if (--BatteryCountdown == 0) {
+		BatteryCountdown = BATTERY_SAMPLE_PERIOD;
+		BatterySampleDue = true;
+	}
 }
 
 // Timer 0 interrupt
 ISR(TIMER0_OVF_vect) {
 	static uint8_t key_state;		// debounced and inverted key state:
 	static uint8_t ct0, ct1;      // holds two bit counter for each key
+	static uint8_t hd0, hd1;      // two bit hold counter for each key
+	static uint8_t key_held;      // hold already reported
+	static uint8_t hold_prescale;
 	uint8_t i;
 
 	if (Buzzer > 0)	Buzzer--;
 
 	/*
 	* read current state of keys (active-low),
-	* clear corresponding bit in i when key has changed
+	* clear corresponding bit in i when key has changed.
+	* Only the key pins count: the rest of the port (buzzer
+	* outputs, TWI, floating pins) would debounce as pressed
 	*/
-	i = key_state ^ ~KEY_PIN;   // key changed ?
+	i = (key_state ^ ~KEY_PIN) & KEY_ALL_MASK;   // key changed ?
   
 	/* 
 	* ct0 and ct1 form a two bit counter for each key,  
@@ -519,6 +369,31 @@ ISR(TIMER0_OVF_vect) {
 	* The main loop needs to clear this bit
 	*/
 	key_press |= key_state & i;	// 0->1: key press detect
+	
+	/*
+	* A press while another key is down reports the keys down as a chord,
+	* and swallows their single presses. x & (x - 1) is non-zero when
+	* more than one bit is set.
+	*/
+	if ((key_state & i) && (key_state & (key_state - 1))) {
+		key_chord = key_state;
+		key_press &= ~key_state;
+	}
+	
+	/*
+	* hd0 and hd1 count how long each key has been down, stepped every
+	* KEY_HOLD_PRESCALE ticks. Reaching 3 reports a hold, once per press.
+	*/
+	key_held &= key_state;		// re-arm on release
+	if (++hold_prescale >= KEY_HOLD_PRESCALE) {
+		hold_prescale = 0;
+		i = key_state & ~key_held;
+		hd1 = (hd1 ^ hd0) & i;
+		hd0 = ~hd0 & i;
+		i &= hd0 & hd1;
+		key_held |= i;
+		key_hold |= i;
+	}
 }
 
 uint8_t digitToSevenSegment(uint8_t digit) {
@@ -544,19 +419,66 @@ uint8_t digitToSevenSegment(uint8_t digit) {
 	}
 }
 
-void showDigit(uint8_t digit, uint8_t port) {
-	if (ssState.showdigits & (1 << digit)) {
-		PORTA = 0xFF; // Avoid ghosting
-		PORTB = (1 << port);
-		PORTA = ~(digitToSevenSegment(ssState.digits[digit]) | (ssState.dots & (1 << digit) ? 1 << PA7 : 0));
+// Segments for a digit, including dots, animations and the low battery warning
+uint8_t digitPattern(uint8_t digit) {
+	bool warning = batteryProfile()->Warning && BatteryBlink && digit == DIGIT_WARNING;
+	uint8_t segments;
+
+	if (animationSegments(digit, &segments)) {
+		return segments;
+	} else if (Machine.Display.showdigits & (1 << digit)) {
+		return digitToSevenSegment(Machine.Display.digits[digit]) | (Machine.Display.dots & (1 << digit) || warning ? 1 << PA7 : 0);
+	} else if (warning) {
+		return GLYPH_LOW_BATTERY;
 	}
-	_delay_us(10000);
+	return 0;
+}
+
+void showDigit(uint8_t digit, uint8_t port) {
+	uint8_t segments = digitPattern(digit);
+
+	PORTA = 0xFF; // Avoid ghosting
+	PORTB = (1 << port);
+	PORTA = ~segments;
+}
+
+#ifdef DISPLAY_SHIFT_REGISTER
+void showDisplay(void) {
+	uint8_t frame[DISPLAY_DIGITS];
+	uint8_t digit;
+
+	for (digit = 0; digit < DISPLAY_DIGITS; digit++) frame[digit] = digitPattern(digit);
+	shiftDisplayWrite(frame);
 }
+#endif
 
 bool detectKeypress(uint8_t mask) {
-	if (key_press & mask) {
-		key_press ^= mask;
-		return true;
+	bool pressed;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		pressed = (key_press & mask) != 0;
+		key_press &= ~mask;
+	}
+	return pressed;
+}
+
+bool detectHold(uint8_t mask) {
+	bool held;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		held = (key_hold & mask) != 0;
+		key_hold &= ~mask;
+	}
+	return held;
+}
+
+// True when exactly the keys in mask were pressed together
+bool detectChord(uint8_t mask) {
+	bool chord;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		chord = key_chord == mask;
+		if (chord) key_chord = 0;
 	}
-	return false;
-}
\ No newline at end of file
+	return chord;
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+/*
+ * BudsWatch.h
+ *
+ * Types shared between the main state machine and its subsystems.
+ */
+#ifndef BUDSWATCH_H_
+#define BUDSWATCH_H_
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 8000000UL // 8Mhz Crystal Oscillator
+#endif
+
+// 4 to 8 digits with DISPLAY_SHIFT_REGISTER, 4 when driven directly
+#ifndef DISPLAY_DIGITS
+#define DISPLAY_DIGITS 4
+#endif
+#if DISPLAY_DIGITS < 4 || DISPLAY_DIGITS > 8 || (DISPLAY_DIGITS > 4 && !defined(DISPLAY_SHIFT_REGISTER))
+#error "Unsupported DISPLAY_DIGITS"
+#endif
+
+#define DISPLAY_UNITS		4	// Scheduler ticks per display slot
+#define DISPLAY_SLOTS		4	// Slots per display frame
+#define DISPLAY_FRAME		(DISPLAY_SLOTS * DISPLAY_UNITS)	// Ticks per display frame
+
+#define DIGIT0				0
+#define DIGIT1				1
+#define DIGIT2				2
+#define DIGIT3				3
+
+#define DIGIT_B				10
+#define DIGIT_U				11
+#define DIGIT_D				12
+#define DIGIT_S				13
+
+// Define enums
+typedef enum {
+	STATE_SELECT,
+	STATE_CONFIGURE,
+	STATE_PRECOUNT,
+	STATE_RUNNING,
+	STATE_FINISHED
+} state;
+
+typedef enum {
+	MODE_STOPWATCH = 1,	// Stopwatch: Count from 0
+	MODE_TIMER = 2,     // Count down from selected time
+	MODE_INTERVAL = 3,  // x sec work, y sec pause, z rounds
+	MODE_TABATA = 4,    // 20 sec work, 10 sec pause, 8 rounds
+	MODE_FGB = 5,
+	MODE_LAST = MODE_FGB
+} mode;
+
+typedef enum {
+	CONF_WORK_MINUTES,
+	CONF_WORK_SECONDS,
+	CONF_REST_MINUTES,
+	CONF_REST_SECONDS,
+	CONF_ROUNDS,
+	CONF_LAST = CONF_ROUNDS
+} interval_configure;
+
+// Define structs
+typedef struct {
+	uint8_t Minutes;
+	uint8_t Seconds;
+} clock;
+
+typedef struct {
+	uint8_t digits[DISPLAY_DIGITS];
+	uint8_t showdigits;
+	uint8_t dots;
+} seven_segment_state;
+
+typedef struct {
+	clock Work;
+	clock Pause;
+	uint8_t RoundsWork;
+	uint8_t RoundsPause;
+} interval_timer;
+
+#endif /* BUDSWATCH_H_ */
@@ -0,0 +1,177 @@
+/*
+ * HistoryLog.c
+ *
+ * See HistoryLog.h for the record format.
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
+#include "HistoryLog.h"
+
+// Pending record, written by the EEPROM-ready interrupt
+static volatile uint8_t HistoryRecord[HISTORY_RECORD_MAX];
+static volatile uint8_t HistoryLength = 0;   // 0 = nothing pending
+static volatile uint8_t HistoryStep = 0;
+static volatile uint16_t HistoryHead = 0;    // offset of the end marker
+
+// Bulk dump, sent by the USART data register empty interrupt
+static volatile uint16_t DumpRemaining = 0;
+static volatile uint16_t DumpAddress = 0;
+
+// Last record written, used for delta encoding
+static interval_timer HistoryLast;
+static uint8_t HistoryUntilKey = 0;
+
+static uint16_t historyAddress(uint16_t offset);
+static bool historyMarker(uint16_t offset);
+
+void historyInit(void) {
+	uint16_t i;
+	bool previous, marker;
+
+	/*
+	 * The end marker follows the newest record. Power loss in the middle of
+	 * a record leaves its new marker up to HISTORY_RECORD_MAX bytes after the
+	 * old one, which still holds the header slot: the earlier of the two in
+	 * ring order stays the head and the later one is cleared. A marker right
+	 * after another is erased EEPROM, not the end of a record.
+	 */
+	HistoryHead = HISTORY_SIZE;
+	previous = historyMarker(HISTORY_SIZE - 1);
+	for (i = 0; i < HISTORY_SIZE; i++) {
+		marker = historyMarker(i);
+		if (marker && HistoryHead == HISTORY_SIZE) {
+			HistoryHead = i;
+		} else if (marker && !previous) {
+			if (i - HistoryHead <= HISTORY_RECORD_MAX) {
+				eeprom_write_byte((uint8_t *)historyAddress(i), 0);
+			} else if (HistoryHead + HISTORY_SIZE - i <= HISTORY_RECORD_MAX) {
+				eeprom_write_byte((uint8_t *)historyAddress(HistoryHead), 0);
+				HistoryHead = i;
+			}
+		}
+		previous = marker;
+	}
+	if (HistoryHead == HISTORY_SIZE) HistoryHead = 0;
+	HistoryUntilKey = 0;
+
+	/* SET UP USART */
+	UBRRH = HISTORY_UBRR >> 8;
+	UBRRL = HISTORY_UBRR & 0xFF;
+	UCSRC = (1 << URSEL) | (1 << UCSZ1) | (1 << UCSZ0); // 8N1
+	UCSRB = (1 << RXEN) | (1 << TXEN) | (1 << RXCIE);
+}
+
+bool historyAppend(mode Mode, const interval_timer *config, uint8_t roundsCompleted, uint32_t duration, bool aborted) {
+	uint8_t record[HISTORY_RECORD_MAX];
+	uint8_t flags = aborted ? HISTORY_F_ABORTED : 0;
+	uint8_t length = 1;
+	uint8_t i;
+
+	if (HistoryLength > 0) return false; // Previous record still being written
+
+	if (HistoryUntilKey == 0) {
+		flags |= HISTORY_F_WORK | HISTORY_F_PAUSE | HISTORY_F_ROUNDS;
+		HistoryUntilKey = HISTORY_KEY_INTERVAL;
+	} else {
+		if (config->Work.Minutes != HistoryLast.Work.Minutes || config->Work.Seconds != HistoryLast.Work.Seconds) flags |= HISTORY_F_WORK;
+		if (config->Pause.Minutes != HistoryLast.Pause.Minutes || config->Pause.Seconds != HistoryLast.Pause.Seconds) flags |= HISTORY_F_PAUSE;
+		if (config->RoundsWork != HistoryLast.RoundsWork) flags |= HISTORY_F_ROUNDS;
+	}
+	HistoryUntilKey--;
+	HistoryLast = *config;
+
+	if (flags & HISTORY_F_WORK) {
+		record[length++] = config->Work.Minutes;
+		record[length++] = config->Work.Seconds;
+	}
+	if (flags & HISTORY_F_PAUSE) {
+		record[length++] = config->Pause.Minutes;
+		record[length++] = config->Pause.Seconds;
+	}
+	if (flags & HISTORY_F_ROUNDS) {
+		record[length++] = config->RoundsWork;
+	}
+	record[length++] = roundsCompleted;
+
+	if (duration > 0x3FFFF) duration = 0x3FFFF; // 3 bytes of 6 bits
+	while (duration > 0x3F) {
+		record[length++] = (duration & 0x3F) | 0x40;
+		duration >>= 6;
+	}
+	record[length++] = duration;
+
+	record[0] = 0x80 | ((Mode & 0x07) << 4) | flags;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		for (i = 0; i < length; i++) HistoryRecord[i] = record[i];
+		HistoryStep = 0;
+		HistoryLength = length;
+		if (DumpRemaining == 0) EECR |= (1 << EERIE);
+	}
+	return true;
+}
+
+static uint16_t historyAddress(uint16_t offset) {
+	return HISTORY_START + (offset % HISTORY_SIZE);
+}
+
+static bool historyMarker(uint16_t offset) {
+	return eeprom_read_byte((const uint8_t *)historyAddress(offset)) == HISTORY_END_MARKER;
+}
+
+/*
+ * One byte per interrupt: the new end marker first, then the payload and
+ * finally the header, so a record interrupted by power loss is never seen;
+ * historyInit() clears the marker it leaves behind.
+ * The interrupt after the last byte only retires the record.
+ */
+ISR(EE_RDY_vect) {
+	uint8_t offset, data;
+
+	if (HistoryStep > HistoryLength) {
+		HistoryHead = (HistoryHead + HistoryLength) % HISTORY_SIZE;
+		HistoryLength = 0;
+		EECR &= ~(1 << EERIE);
+		if (DumpRemaining > 0) {
+			DumpAddress = HistoryHead + 1;
+			UCSRB |= (1 << UDRIE);
+		}
+		return;
+	}
+
+	if (HistoryStep == 0) {
+		offset = HistoryLength;
+		data = HISTORY_END_MARKER;
+	} else if (HistoryStep < HistoryLength) {
+		offset = HistoryStep;
+		data = HistoryRecord[offset];
+	} else {
+		offset = 0;
+		data = HistoryRecord[0];
+	}
+	HistoryStep++;
+
+	EEAR = historyAddress(HistoryHead + offset);
+	EEDR = data;
+	EECR |= (1 << EEMWE);
+	EECR |= (1 << EEWE);
+}
+
+ISR(USART_RXC_vect) {
+	if (UDR == HISTORY_DUMP_COMMAND && DumpRemaining == 0) {
+		DumpAddress = HistoryHead + 1;
+		DumpRemaining = HISTORY_SIZE;
+		if (HistoryLength == 0) UCSRB |= (1 << UDRIE);
+	}
+}
+
+ISR(USART_UDRE_vect) {
+	// Only enabled while no EEPROM write is in progress
+	UDR = eeprom_read_byte((const uint8_t *)historyAddress(DumpAddress++));
+	if (--DumpRemaining == 0) {
+		UCSRB &= ~(1 << UDRIE);
+		if (HistoryLength > 0) EECR |= (1 << EERIE);
+	}
+}
@@ -0,0 +1,58 @@
+/*
+ * HistoryLog.h
+ *
+ * Workout history kept in EEPROM as a circular log of delta-encoded records,
+ * written one byte per EEPROM-ready interrupt and dumped over the USART.
+ *
+ * Record layout (all payload bytes have bit 7 clear):
+ *   header    1MMM FFFF    M = mode, F = HISTORY_F_* flags
+ *   work      mm ss        only if HISTORY_F_WORK
+ *   pause     mm ss        only if HISTORY_F_PAUSE
+ *   rounds    n            only if HISTORY_F_ROUNDS (configured rounds)
+ *   completed n            rounds completed
+ *   duration  1-3 bytes    seconds, 6 bits per byte LSB first, bit 6 = more
+ *
+ * Omitted fields repeat the previous record. Every HISTORY_KEY_INTERVAL
+ * records (and the first after power-up) carry all fields, so a reader that
+ * starts after the ring has wrapped resynchronises quickly. The byte after
+ * the newest record is always 0xFF, which no record byte can be.
+ *
+ * Sending 'D' on the serial port streams the whole ring, oldest byte first,
+ * ending with the 0xFF marker.
+ */
+#ifndef HISTORYLOG_H_
+#define HISTORYLOG_H_
+
+#include <avr/io.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "BudsWatch.h"
+
+#define HISTORY_START			0
+#define HISTORY_SIZE			(E2END + 1)
+#define HISTORY_KEY_INTERVAL	8
+#define HISTORY_RECORD_MAX		10
+#define HISTORY_END_MARKER		0xFF
+
+#define HISTORY_F_WORK			(1 << 0)
+#define HISTORY_F_PAUSE			(1 << 1)
+#define HISTORY_F_ROUNDS		(1 << 2)
+#define HISTORY_F_ABORTED		(1 << 3)
+
+#define HISTORY_DUMP_COMMAND	'D'
+#define HISTORY_BAUD			38400
+#define HISTORY_UBRR			((F_CPU + 8UL * HISTORY_BAUD) / (16UL * HISTORY_BAUD) - 1)
+
+// A finished or aborted session waiting for historyAppend()
+typedef struct {
+	mode Mode;
+	interval_timer Config;
+	uint8_t Completed;
+	uint32_t Duration;		// Seconds
+	bool Aborted;
+} history_entry;
+
+void historyInit(void);
+bool historyAppend(mode Mode, const interval_timer *config, uint8_t roundsCompleted, uint32_t duration, bool aborted);
+
+#endif /* HISTORYLOG_H_ */
@@ -0,0 +1,83 @@
+/*
+ * Scheduler.c
+ *
+ * See Scheduler.h.
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "Scheduler.h"
+
+static volatile uint8_t SchedTicks = 0;
+static sched_task *Tasks;
+static uint8_t TaskCount = 0;
+static uint8_t Slips = 0;
+
+static void schedNow(uint8_t *ticks, uint8_t *counts);
+
+void schedInit(void) {
+	// Timer 2: Scheduler tick
+	TCCR2 = (1 << WGM21) | (1 << CS21) | (1 << CS20);  // CTC, Fcpu/32
+	OCR2 = SCHED_COUNTS_PER_TICK - 1;
+	TIMSK |= (1 << OCIE2);
+}
+
+void schedRun(sched_task *tasks, uint8_t count) {
+	uint8_t tick = SchedTicks;
+	uint8_t startTicks, startCounts, endTicks, endCounts;
+	uint16_t elapsed;
+	uint8_t i;
+
+	Tasks = tasks;
+	TaskCount = count;
+	for (i = 0; i < count; i++) tasks[i].Countdown = tasks[i].Offset;
+
+	for (;;)
+	{
+		while (SchedTicks == tick);
+		tick++;
+		if (SchedTicks != tick && Slips < 255) Slips++;
+
+		for (i = 0; i < count; i++) {
+			sched_task *task = &tasks[i];
+
+			if (task->Countdown > 0) {
+				task->Countdown--;
+				continue;
+			}
+			task->Countdown = task->Period - 1;
+
+			schedNow(&startTicks, &startCounts);
+			task->Run();
+			schedNow(&endTicks, &endCounts);
+
+			elapsed = (uint8_t)(endTicks - startTicks) * SCHED_COUNTS_PER_TICK + endCounts - startCounts;
+			if (elapsed > task->Budget && task->Overruns < 255) task->Overruns++;
+		}
+	}
+}
+
+uint8_t schedOverruns(void) {
+	uint16_t total = 0;
+	uint8_t i;
+
+	for (i = 0; i < TaskCount; i++) total += Tasks[i].Overruns;
+	return total > 255 ? 255 : total;
+}
+
+uint8_t schedSlips(void) {
+	return Slips;
+}
+
+static void schedNow(uint8_t *ticks, uint8_t *counts) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		*ticks = SchedTicks;
+		*counts = TCNT2;
+		// Compare match not yet serviced
+		if ((TIFR & (1 << OCF2)) && *counts < SCHED_COUNTS_PER_TICK / 2) (*ticks)++;
+	}
+}
+
+ISR(TIMER2_COMP_vect) {
+	SchedTicks++;
+}
@@ -0,0 +1,34 @@
+/*
+ * Scheduler.h
+ *
+ * Time-triggered cooperative scheduler. Timer 2 produces one tick every
+ * SCHED_TICK_US, and the dispatcher runs each task of a static table every
+ * Period ticks, starting Offset ticks in. Tasks run to completion, so each
+ * declares its worst case Budget; runs exceeding it are counted per task,
+ * and ticks dispatched late because earlier work ran long count as slips.
+ */
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdint.h>
+
+#define SCHED_TICK_US			500
+#define SCHED_COUNTS_PER_TICK	125		// Timer 2 at Fcpu/32
+#define SCHED_TICKS(ms)			((uint16_t)((ms) * 1000UL / SCHED_TICK_US))
+#define SCHED_US(us)			((uint16_t)((us) * (unsigned long)SCHED_COUNTS_PER_TICK / SCHED_TICK_US))
+
+typedef struct {
+	void (*Run)(void);
+	uint16_t Period;		// Ticks
+	uint16_t Offset;		// Ticks
+	uint16_t Budget;		// Timer 2 counts, see SCHED_US()
+	uint16_t Countdown;
+	uint8_t Overruns;
+} sched_task;
+
+void schedInit(void);
+void schedRun(sched_task *tasks, uint8_t count);
+uint8_t schedOverruns(void);
+uint8_t schedSlips(void);
+
+#endif /* SCHEDULER_H_ */
@@ -0,0 +1,60 @@
+/*
+ * ShiftDisplay.c
+ *
+ * See ShiftDisplay.h.
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "ShiftDisplay.h"
+
+static uint8_t Shown[DISPLAY_DIGITS];
+static volatile uint8_t Buffer[DISPLAY_DIGITS];
+static volatile uint8_t Index = 0;
+static volatile bool Busy = false;
+
+void shiftDisplayInit(void) {
+	uint8_t i;
+
+	SHIFT_PORT |= SHIFT_OE_MASK;
+	SHIFT_DDR |= SHIFT_LATCH_MASK | SHIFT_MOSI_MASK | SHIFT_SCK_MASK | SHIFT_OE_MASK;
+	SPCR = (1 << SPIE) | (1 << SPE) | (1 << MSTR) | (1 << SPR0); // Fcpu/16, MSB first
+
+	// Force the first frame out
+	for (i = 0; i < DISPLAY_DIGITS; i++) Shown[i] = 0xFF;
+}
+
+// Starts sending frame unless it is already shown or a transfer is running
+bool shiftDisplayWrite(const uint8_t *frame) {
+	bool changed = false;
+	uint8_t i;
+
+	if (Busy) return false;
+
+	// The first byte sent ends up in the last register
+	for (i = 0; i < DISPLAY_DIGITS; i++) {
+		if (Shown[i] != frame[i]) changed = true;
+		Shown[i] = frame[i];
+		Buffer[DISPLAY_DIGITS - 1 - i] = frame[i];
+	}
+	if (!changed) return false;
+
+	Busy = true;
+	Index = 1;
+	SPDR = Buffer[0];
+	return true;
+}
+
+void shiftDisplayEnable(bool enable) {
+	if (enable) SHIFT_PORT &= ~SHIFT_OE_MASK;
+	else SHIFT_PORT |= SHIFT_OE_MASK;
+}
+
+ISR(SPI_STC_vect) {
+	if (Index < DISPLAY_DIGITS) {
+		SPDR = Buffer[Index++];
+	} else {
+		SHIFT_PORT |= SHIFT_LATCH_MASK;
+		SHIFT_PORT &= ~SHIFT_LATCH_MASK;
+		Busy = false;
+	}
+}
@@ -0,0 +1,31 @@
+/*
+ * ShiftDisplay.h
+ *
+ * Display backend for 74HC595/TPIC6B595 style shift registers, one register
+ * per digit, daisy-chained over the hardware SPI port. The registers hold
+ * the segments statically, so nothing is multiplexed: a frame is only sent
+ * when it changes, DISPLAY_DIGITS bytes from the SPI interrupt, and then
+ * latched. PB3 drives the shared output enable used for dimming.
+ *
+ * The register nearest the MCU is DIGIT0. Segment bits are active high,
+ * a..g in bits 0..6 and the dot in bit 7.
+ */
+#ifndef SHIFTDISPLAY_H_
+#define SHIFTDISPLAY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "BudsWatch.h"
+
+#define SHIFT_DDR				DDRB
+#define SHIFT_PORT				PORTB
+#define SHIFT_LATCH_MASK		(1 << PB4)	// RCK, also keeps SS an output
+#define SHIFT_MOSI_MASK			(1 << PB5)
+#define SHIFT_SCK_MASK			(1 << PB7)
+#define SHIFT_OE_MASK			(1 << PB3)	// Active low
+
+void shiftDisplayInit(void);
+bool shiftDisplayWrite(const uint8_t *frame);
+void shiftDisplayEnable(bool enable);
+
+#endif /* SHIFTDISPLAY_H_ */
@@ -0,0 +1,416 @@
+/*
+ * StateMachine.c
+ *
+ * Mode selection, configuration, precount and the running session.
+ */
+#include "StateMachine.h"
+
+extern double floor(double x);
+
+static void machineStart(state_machine *m, const machine_setup *setup);
+
+void machineInit(state_machine *m) {
+	m->State = STATE_SELECT;
+	m->Mode = MODE_STOPWATCH;
+	m->Interval = false;
+	m->Paused = false;
+	m->PreCount = PRECOUNT;
+	m->BuzzCount = 0;
+	m->Minutes = 0;
+	m->Seconds = 0;
+	m->intervalConfiguration = CONF_WORK_MINUTES;
+	m->Display.showdigits = 0;
+	m->Display.dots = 0;
+}
+
+void machineStep(state_machine *m, const machine_input *in, machine_output *out) {
+	bool tick = in->Tick;
+	bool reset = false;
+
+	out->Beep = BEEP_NONE;
+	out->Ended = SESSION_RUNNING;
+	out->Completed = 0;
+	out->Phase = SEGMENT_NONE;
+
+	// Gestures: KEY3 pauses, the abort gesture returns to mode select
+	if (in->Presses & MACHINE_KEY3) {
+		if (m->State == STATE_PRECOUNT || m->State == STATE_RUNNING) m->Paused = !m->Paused;
+	}
+	if (in->Abort) {
+		if (m->State != STATE_SELECT) reset = true;
+	}
+
+	switch (in->Command)
+	{
+		case COMMAND_START:
+			if (m->State == STATE_SELECT || m->State == STATE_CONFIGURE) machineStart(m, &in->Setup);
+			break;
+		case COMMAND_PAUSE:
+			if (m->State == STATE_PRECOUNT || m->State == STATE_RUNNING) m->Paused = !m->Paused;
+			break;
+		case COMMAND_RESET:
+			reset = true;
+			break;
+		default:
+			break;
+	}
+
+	if (m->Paused) tick = false;
+
+	if (reset) {
+		if (m->State == STATE_RUNNING) {
+			out->Ended = SESSION_ABORTED;
+			out->Completed = timelineCompleted(&m->Timeline);
+		}
+		m->State = STATE_SELECT;
+		m->PreCount = PRECOUNT;
+		m->intervalConfiguration = CONF_WORK_MINUTES;
+		m->BuzzCount = 0;
+		m->Paused = false;
+		out->Beep = BEEP_SILENCE;
+	}
+
+	switch (m->State)
+	{
+	    case STATE_SELECT:
+			if (in->Presses & MACHINE_KEY0)
+			{
+				m->clockState.Minutes = 0;
+				m->clockState.Seconds = 0;
+				m->Interval = m->Mode != MODE_STOPWATCH;
+				m->State = modeDefaults(m->Mode, &m->intervalState);
+			}
+			if (in->Presses & MACHINE_KEY1) {
+				if (++m->Mode > MODE_LAST) m->Mode = MODE_STOPWATCH;
+			}
+			if (in->Presses & MACHINE_KEY2) {
+				if (--m->Mode < 1) m->Mode = MODE_LAST;
+			}
+		
+			m->Display.showdigits = (1 << DIGIT0);
+			m->Display.digits[DIGIT0] = m->Mode;
+			
+			if (tick) {
+				m->Display.dots ^= (1 << DIGIT0);
+			}
+			break;
+		case STATE_CONFIGURE:
+			switch (m->Mode)
+			{
+				case MODE_TIMER:
+					if (in->Presses & MACHINE_KEY0) {
+						m->State = STATE_PRECOUNT;							
+					}
+					if (in->Presses & MACHINE_KEY1) {
+						if (m->intervalState.Work.Minutes >= 59) m->intervalState.Work.Minutes = 0;
+						else m->intervalState.Work.Minutes++;							
+					}
+					if (in->Presses & MACHINE_KEY2) {
+						if (m->intervalState.Work.Minutes == 0) m->intervalState.Work.Minutes = 59;
+						else m->intervalState.Work.Minutes--;
+					}
+					m->Minutes = m->intervalState.Work.Minutes;
+					m->Seconds = m->intervalState.Work.Seconds;
+					m->Display.showdigits = (1 << DIGIT3) | (1 << DIGIT2);
+					break;
+				case MODE_INTERVAL:
+					switch (m->intervalConfiguration) {
+						case CONF_WORK_MINUTES:
+							if (in->Presses & MACHINE_KEY0) {
+								m->intervalConfiguration++;
+							}
+							if (in->Presses & MACHINE_KEY1) {
+								if (m->intervalState.Work.Minutes >= 59) m->intervalState.Work.Minutes = 0;
+								else m->intervalState.Work.Minutes++;
+							}
+							if (in->Presses & MACHINE_KEY2) {
+								if (m->intervalState.Work.Minutes == 0) m->intervalState.Work.Minutes = 59;
+								else m->intervalState.Work.Minutes--;
+							}
+							m->Minutes = m->intervalState.Work.Minutes;
+							m->Seconds = m->intervalState.Work.Seconds;
+							m->Display.showdigits = (1 << DIGIT3) | (1 << DIGIT2);
+							break;
+						case CONF_WORK_SECONDS:
+							if (in->Presses & MACHINE_KEY0) {
+								m->intervalConfiguration++;
+							}
+							if (in->Presses & MACHINE_KEY1) {
+								if (m->intervalState.Work.Seconds >= 59) m->intervalState.Work.Seconds = 0;
+								else m->intervalState.Work.Seconds++;
+							}
+							if (in->Presses & MACHINE_KEY2) {
+								if (m->intervalState.Work.Seconds == 0) m->intervalState.Work.Seconds = 59;
+								else m->intervalState.Work.Seconds--;
+							}
+							m->Minutes = m->intervalState.Work.Minutes;
+							m->Seconds = m->intervalState.Work.Seconds;
+							m->Display.showdigits = (1 << DIGIT0) | (1 << DIGIT1);
+							break;
+						case CONF_REST_MINUTES:
+							if (in->Presses & MACHINE_KEY0) {
+								m->intervalConfiguration++;
+							}
+							if (in->Presses & MACHINE_KEY1) {
+								if (m->intervalState.Pause.Minutes >= 59) m->intervalState.Pause.Minutes = 0;
+								else m->intervalState.Pause.Minutes++;
+							}
+							if (in->Presses & MACHINE_KEY2) {
+								if (m->intervalState.Pause.Minutes == 0) m->intervalState.Pause.Minutes = 59;
+								else m->intervalState.Pause.Minutes--;
+							}
+							m->Minutes = m->intervalState.Pause.Minutes;
+							m->Seconds = m->intervalState.Pause.Seconds;
+							m->Display.showdigits = (1 << DIGIT3) | (1 << DIGIT2);
+							break;
+						case CONF_REST_SECONDS:
+							if (in->Presses & MACHINE_KEY0) {
+								m->intervalConfiguration++;
+							}
+							if (in->Presses & MACHINE_KEY1) {
+								if (m->intervalState.Pause.Seconds >= 59) m->intervalState.Pause.Seconds = 0;
+								else m->intervalState.Pause.Seconds++;
+							}
+							if (in->Presses & MACHINE_KEY2) {
+								if (m->intervalState.Pause.Seconds == 0) m->intervalState.Pause.Seconds = 59;
+								else m->intervalState.Pause.Seconds--;
+							}
+							m->Minutes = m->intervalState.Pause.Minutes;
+							m->Seconds = m->intervalState.Pause.Seconds;
+							m->Display.showdigits = (1 << DIGIT0) | (1 << DIGIT1);
+							break;
+						case CONF_ROUNDS:
+							if (in->Presses & MACHINE_KEY0) {
+								m->State = STATE_PRECOUNT;
+							}
+							if (in->Presses & MACHINE_KEY1) {
+								if (m->intervalState.RoundsWork >= 99) {
+									m->intervalState.RoundsWork = 0;
+									m->intervalState.RoundsPause = 0;
+								} else {
+									m->intervalState.RoundsWork++;
+									if (m->intervalState.Pause.Minutes > 0 || m->intervalState.Pause.Seconds > 0) m->intervalState.RoundsPause++;
+								}										
+							}
+							if (in->Presses & MACHINE_KEY2) {
+								if (m->intervalState.RoundsWork == 0) {
+									m->intervalState.RoundsWork = 99;
+									if (m->intervalState.Pause.Minutes > 0 || m->intervalState.Pause.Seconds > 0) m->intervalState.RoundsPause = 99;
+								} else {
+									m->intervalState.RoundsWork--;
+									if ((m->intervalState.Pause.Minutes > 0 || m->intervalState.Pause.Seconds > 0) && m->intervalState.RoundsPause > 0) m->intervalState.RoundsPause--;
+								}	
+							}
+							m->Minutes = m->intervalState.RoundsWork;
+							m->Seconds = m->intervalState.RoundsPause;
+							m->Display.showdigits = (1 << DIGIT3) | (1 << DIGIT2) | (1 << DIGIT1) | (1 << DIGIT0);
+							
+							break;
+						default:
+							break;
+					}
+					break;
+			    default:
+			        m->Display.showdigits = 0;
+			        break;
+			}
+			m->Display.digits[DIGIT3] = floor(m->Minutes / 10);
+			m->Display.digits[DIGIT2] = m->Minutes % 10;
+			m->Display.digits[DIGIT1] = floor(m->Seconds / 10);
+			m->Display.digits[DIGIT0] = m->Seconds % 10;
+			m->Display.dots = 0;
+			break;
+		case STATE_PRECOUNT:
+			if (tick) {
+				m->Display.digits[DIGIT1] = floor(m->PreCount / 10);
+				m->Display.digits[DIGIT0] = m->PreCount % 10;
+				m->Display.showdigits = (1 << DIGIT0) | (m->PreCount > 9 ? (1 << DIGIT1) : 0);
+				m->Display.dots = (m->PreCount % 2 == 0 ? (1 << DIGIT0) : 0);
+				if (m->PreCount == DEFAULT_BUZZCOUNT-1) m->BuzzCount = DEFAULT_BUZZCOUNT;
+
+				if (m->BuzzCount > 1) {
+					out->Beep = BEEP_SHORT;
+					m->BuzzCount--;
+				}
+				else if (m->BuzzCount == 1) {
+					out->Beep = BEEP_LONG;
+					m->BuzzCount--;
+				}
+
+				m->PreCount--;
+				if (m->PreCount == 0) {
+					m->sessionState = m->intervalState;
+					m->SessionSeconds = 0;
+					timelineStart(&m->Timeline, &m->intervalState);
+					m->Phase = SEGMENT_NONE;
+					m->State = STATE_RUNNING;
+				}
+			}
+			break;
+		case STATE_RUNNING:
+			if (tick) {
+				if (m->BuzzCount > 1) {
+					out->Beep = BEEP_SHORT;
+					m->BuzzCount--;
+				}
+				else if (m->BuzzCount == 1) {
+					out->Beep = BEEP_LONG;
+					m->BuzzCount--;
+				}
+				
+				if (m->Interval)
+				{
+					out->Phase = timelineStep(&m->Timeline);
+					switch (out->Phase)
+					{
+						case SEGMENT_WORK:
+							m->intervalState.RoundsWork--;
+							m->Phase = SEGMENT_WORK;
+							break;
+						case SEGMENT_PAUSE:
+							m->intervalState.RoundsPause--;
+							m->Phase = SEGMENT_PAUSE;
+							break;
+						case SEGMENT_END:
+							out->Ended = SESSION_FINISHED;
+							out->Completed = timelineCompleted(&m->Timeline);
+							m->State = STATE_FINISHED;
+							m->Phase = SEGMENT_NONE;
+							break;
+						default:
+							break;
+					}
+					m->clockState = m->Timeline.Left;
+				}
+
+				m->Display.showdigits = (1 << DIGIT0) | (1 << DIGIT1) | (1 << DIGIT2) | (1 << DIGIT3);
+				if (m->clockState.Seconds % 2 == 1) m->Display.dots = DOT_SECONDS;
+				else m->Display.dots = 0;
+				if (m->Phase == SEGMENT_WORK) m->Display.dots |= DOT_WORK;
+				else if (m->Phase == SEGMENT_PAUSE) m->Display.dots |= DOT_REST;
+				
+				// BUDS
+				if (m->clockState.Minutes == 0 && m->clockState.Seconds == 0) {
+					m->Display.digits[DIGIT3] = DIGIT_B;
+					m->Display.digits[DIGIT2] = DIGIT_U;
+					m->Display.digits[DIGIT1] = DIGIT_D;
+					m->Display.digits[DIGIT0] = DIGIT_S;
+				} else {
+					if (m->Mode == MODE_TABATA) {
+						m->Display.showdigits = (1 << DIGIT0) | (1 << DIGIT1) |  (1 << DIGIT3);
+						m->Display.digits[DIGIT3] = m->intervalState.RoundsPause;
+						m->Display.digits[DIGIT2] = 0;
+						m->Display.digits[DIGIT1] = floor(m->clockState.Seconds / 10);
+						m->Display.digits[DIGIT0] = m->clockState.Seconds % 10;	
+					} else {
+						m->Display.digits[DIGIT3] = floor(m->clockState.Minutes / 10);
+						m->Display.digits[DIGIT2] = m->clockState.Minutes % 10;
+						m->Display.digits[DIGIT1] = floor(m->clockState.Seconds / 10);
+						m->Display.digits[DIGIT0] = m->clockState.Seconds % 10;
+					}
+				}
+					
+				if (m->Interval) {
+					timelineCount(&m->Timeline);
+					if (timelineUntilBoundary(&m->Timeline) == DEFAULT_BUZZCOUNT-1) {
+						m->BuzzCount = DEFAULT_BUZZCOUNT;
+					}
+				}
+				else
+				{
+					m->clockState.Seconds++;
+					if (m->clockState.Seconds >= 60) {
+						m->clockState.Seconds = 0;
+						m->clockState.Minutes++;
+						if (m->clockState.Minutes > 59) m->clockState.Minutes = 0;
+					}
+				}
+				
+				m->SessionSeconds++;
+			}
+			break;
+		default:
+			// Do nothing
+			break;
+	}
+}
+
+// Start from the setup over the defaults of its mode, clamped to what the keys could set
+static void machineStart(state_machine *m, const machine_setup *setup) {
+	uint8_t i;
+
+	if ((setup->Written & SETUP_MODE) && setup->Mode >= MODE_STOPWATCH && setup->Mode <= MODE_LAST) {
+		m->Mode = setup->Mode;
+		modeDefaults(m->Mode, &m->intervalState);
+	} else if (m->State == STATE_SELECT) {
+		modeDefaults(m->Mode, &m->intervalState);
+	}
+	for (i = 0; i < SETUP_CONFIG_FIELDS; i++) {
+		if (setup->Written & SETUP_CONFIG(i)) ((uint8_t *)&m->intervalState)[i] = ((const uint8_t *)&setup->Config)[i];
+	}
+	if (m->intervalState.Work.Minutes > 59) m->intervalState.Work.Minutes = 59;
+	if (m->intervalState.Work.Seconds > 59) m->intervalState.Work.Seconds = 59;
+	if (m->intervalState.Pause.Minutes > 59) m->intervalState.Pause.Minutes = 59;
+	if (m->intervalState.Pause.Seconds > 59) m->intervalState.Pause.Seconds = 59;
+	if (m->intervalState.RoundsWork > 99) m->intervalState.RoundsWork = 99;
+	if (m->intervalState.RoundsPause > 99) m->intervalState.RoundsPause = 99;
+	// Tabata shows the rounds left on a single digit
+	if (m->Mode == MODE_TABATA) {
+		if (m->intervalState.RoundsWork > 9) m->intervalState.RoundsWork = 9;
+		if (m->intervalState.RoundsPause > 9) m->intervalState.RoundsPause = 9;
+	}
+
+	m->clockState.Minutes = 0;
+	m->clockState.Seconds = 0;
+	m->Interval = m->Mode != MODE_STOPWATCH;
+	m->State = STATE_PRECOUNT;
+}
+
+// Load the default configuration for Mode, and return the state to continue in
+state modeDefaults(mode Mode, interval_timer *config) {
+	switch (Mode)
+	{
+	    case MODE_STOPWATCH:
+			config->Work.Minutes  = 0;
+			config->Work.Seconds  = 0;
+			config->Pause.Minutes = 0;
+			config->Pause.Seconds = 0;
+			config->RoundsWork    = 0;
+			config->RoundsPause   = 0;
+			return STATE_PRECOUNT;
+		case MODE_TIMER:
+			config->Work.Minutes  = 1;
+			config->Work.Seconds  = 0;
+			config->Pause.Minutes = 1;
+			config->Pause.Seconds = 0;
+			config->RoundsWork    = 1;
+			config->RoundsPause   = 0;
+			return STATE_CONFIGURE;
+		case MODE_INTERVAL:
+			config->Work.Minutes  = 1;
+			config->Work.Seconds  = 0;
+			config->Pause.Minutes = 1;
+			config->Pause.Seconds = 0;
+			config->RoundsWork    = 1;
+			config->RoundsPause   = 0;
+			return STATE_CONFIGURE;
+		case MODE_TABATA:
+			config->Work.Minutes  = 0;
+			config->Work.Seconds  = 20;
+			config->Pause.Minutes = 0;
+			config->Pause.Seconds = 10;
+			config->RoundsWork    = 8;
+			config->RoundsPause   = 8;
+			return STATE_PRECOUNT;
+		case MODE_FGB:
+			config->Work.Minutes  = 1;
+			config->Work.Seconds  = 0;
+			config->Pause.Minutes = 0;
+			config->Pause.Seconds = 0;
+			config->RoundsWork    = 18;
+			config->RoundsPause   = 0;
+			return STATE_PRECOUNT;
+		default:
+			return STATE_SELECT;
+	}
+}
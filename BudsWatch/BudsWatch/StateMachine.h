@@ -0,0 +1,104 @@
+/*
+ * StateMachine.h
+ *
+ * The mode state machine, free of hardware so it also builds on the host.
+ * taskControl() turns debounced keys, the seconds tick and TWI commands into
+ * a machine_input, and acts on the machine_output: beeps and history records.
+ */
+#ifndef STATEMACHINE_H_
+#define STATEMACHINE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "BudsWatch.h"
+#include "Timeline.h"
+
+#define PRECOUNT			10
+#define DEFAULT_BUZZCOUNT	4
+
+/*
+ * Display.dots while running. DIGIT2 blinks with the seconds, DIGIT0 is lit
+ * during work and DIGIT1 during rest. DIGIT3 is left to the low battery
+ * warning (DIGIT_WARNING on a 4 digit display).
+ */
+#define DOT_SECONDS			(1 << DIGIT2)
+#define DOT_WORK			(1 << DIGIT0)
+#define DOT_REST			(1 << DIGIT1)
+
+// machine_input.Presses
+#define MACHINE_KEY0		(1 << 0)	// Select / next
+#define MACHINE_KEY1		(1 << 1)	// Up
+#define MACHINE_KEY2		(1 << 2)	// Down
+#define MACHINE_KEY3		(1 << 3)	// Pause
+
+// machine_setup.Written, one bit per field of Config in order
+#define SETUP_MODE			(1 << 0)
+#define SETUP_CONFIG(i)		(1 << ((i) + 1))
+#define SETUP_CONFIG_FIELDS	sizeof(interval_timer)
+
+typedef enum {
+	COMMAND_NONE,
+	COMMAND_START,
+	COMMAND_PAUSE,
+	COMMAND_RESET
+} machine_command;
+
+typedef enum {
+	BEEP_NONE,
+	BEEP_SHORT,
+	BEEP_LONG,
+	BEEP_SILENCE		// Cut a beep in progress
+} machine_beep;
+
+typedef enum {
+	SESSION_RUNNING,
+	SESSION_FINISHED,
+	SESSION_ABORTED
+} machine_session;
+
+// Start parameters for COMMAND_START, fields not in Written keep the defaults
+typedef struct {
+	uint8_t Written;
+	mode Mode;
+	interval_timer Config;
+} machine_setup;
+
+typedef struct {
+	uint8_t Presses;		// MACHINE_KEY* pressed since the last step
+	bool Abort;				// Chord or hold gesture
+	bool Tick;				// A second has elapsed
+	machine_command Command;
+	machine_setup Setup;
+} machine_input;
+
+typedef struct {
+	machine_beep Beep;
+	machine_session Ended;	// Session ended in this step
+	uint8_t Completed;		// Rounds completed, when Ended
+	segment_kind Phase;		// Segment entered in this step, SEGMENT_END when finished
+} machine_output;
+
+typedef struct {
+	state State;
+	mode Mode;
+	bool Interval;
+	bool Paused;
+	uint8_t PreCount;
+	uint8_t BuzzCount;
+	uint8_t Minutes;		// Configure
+	uint8_t Seconds;		// Configure
+	interval_configure intervalConfiguration;
+	clock clockState;
+	interval_timer intervalState;
+	interval_timer sessionState;	// Configuration as the session started
+	uint32_t SessionSeconds;
+	timeline Timeline;
+	segment_kind Phase;		// Kind of the segment in progress
+	seven_segment_state Display;
+} state_machine;
+
+void machineInit(state_machine *m);
+void machineStep(state_machine *m, const machine_input *in, machine_output *out);
+state modeDefaults(mode Mode, interval_timer *config);
+
+#endif /* STATEMACHINE_H_ */
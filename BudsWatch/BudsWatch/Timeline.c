@@ -0,0 +1,106 @@
+/*
+ * Timeline.c
+ *
+ * See Timeline.h.
+ */
+#include "Timeline.h"
+
+static segment_kind timelineKind(const timeline *t, uint16_t index);
+static uint16_t timelineWorks(const timeline *t, uint16_t count);
+static uint16_t clockSeconds(const clock *c);
+
+/*
+ * Same order as the original round logic: pauses while RoundsPause exceeds
+ * RoundsWork, otherwise work, so the surplus of either kind comes first.
+ */
+void timelineStart(timeline *t, const interval_timer *config) {
+	uint16_t work = clockSeconds(&config->Work);
+	uint16_t pause = clockSeconds(&config->Pause);
+	uint8_t pairs;
+
+	t->Work = config->Work;
+	t->Pause = config->Pause;
+	if (config->RoundsPause > config->RoundsWork) {
+		t->LeadKind = SEGMENT_PAUSE;
+		t->Lead = config->RoundsPause - config->RoundsWork;
+		pairs = config->RoundsWork;
+	} else {
+		t->LeadKind = SEGMENT_WORK;
+		t->Lead = config->RoundsWork - config->RoundsPause;
+		pairs = config->RoundsPause;
+	}
+	t->Segments = t->Lead + 2 * pairs;
+
+	if (work == 0) work = 1;
+	if (pause == 0) pause = 1;
+	t->TotalLeft = (uint32_t)t->Lead * (t->LeadKind == SEGMENT_WORK ? work : pause)
+				 + (uint32_t)pairs * (work + pause);
+
+	t->Entered = 0;
+	t->Left.Minutes = 0;
+	t->Left.Seconds = 0;
+}
+
+// Enters the next segment once the one in progress is used up
+segment_kind timelineStep(timeline *t) {
+	segment_kind kind;
+
+	if (t->Left.Minutes > 0 || t->Left.Seconds > 0) return SEGMENT_NONE;
+	if (t->Entered >= t->Segments) return SEGMENT_END;
+
+	kind = timelineKind(t, t->Entered++);
+	t->Left = kind == SEGMENT_WORK ? t->Work : t->Pause;
+	return kind;
+}
+
+void timelineCount(timeline *t) {
+	if (t->TotalLeft > 0) t->TotalLeft--;
+	if (t->Left.Seconds > 0) {
+		t->Left.Seconds--;
+	} else if (t->Left.Minutes > 0) {
+		t->Left.Minutes--;
+		t->Left.Seconds = 59;
+	}
+}
+
+// Kind of the segment after the one in progress
+segment_kind timelineNext(const timeline *t) {
+	return t->Entered < t->Segments ? timelineKind(t, t->Entered) : SEGMENT_END;
+}
+
+uint16_t timelineUntilBoundary(const timeline *t) {
+	return clockSeconds(&t->Left);
+}
+
+uint32_t timelineRemaining(const timeline *t) {
+	return t->TotalLeft;
+}
+
+// Work round in progress or last started, counting from 1
+uint8_t timelineRound(const timeline *t) {
+	return timelineWorks(t, t->Entered);
+}
+
+uint8_t timelineCompleted(const timeline *t) {
+	uint8_t works = timelineWorks(t, t->Entered);
+
+	if (t->Entered > 0 && timelineKind(t, t->Entered - 1) == SEGMENT_WORK && clockSeconds(&t->Left) > 0) works--;
+	return works;
+}
+
+static segment_kind timelineKind(const timeline *t, uint16_t index) {
+	if (index < t->Lead) return t->LeadKind;
+	return (index - t->Lead) & 1 ? SEGMENT_PAUSE : SEGMENT_WORK;
+}
+
+// Work segments among the first count segments
+static uint16_t timelineWorks(const timeline *t, uint16_t count) {
+	uint16_t lead = t->LeadKind == SEGMENT_WORK ? t->Lead : 0;
+
+	if (count <= t->Lead) return t->LeadKind == SEGMENT_WORK ? count : 0;
+	return lead + (count - t->Lead + 1) / 2;
+}
+
+static uint16_t clockSeconds(const clock *c) {
+	return c->Minutes * 60 + c->Seconds;
+}
@@ -0,0 +1,48 @@
+/*
+ * Timeline.h
+ *
+ * A session expanded at start into its sequence of work and pause segments.
+ * The sequence is always a run of one kind followed by work/pause pairs, so
+ * it is stored run-length encoded and every query is O(1) arithmetic.
+ *
+ * Each running second calls timelineStep() to cross a boundary when the
+ * segment in progress is used up, then timelineCount() to count it down.
+ * A zero length segment still takes one second, showing 0:00.
+ */
+#ifndef TIMELINE_H_
+#define TIMELINE_H_
+
+#include <stdint.h>
+#include "BudsWatch.h"
+
+typedef enum {
+	SEGMENT_NONE,	// Still inside the segment in progress
+	SEGMENT_WORK,
+	SEGMENT_PAUSE,
+	SEGMENT_END
+} segment_kind;
+
+typedef struct {
+	// Layout, fixed at start
+	clock Work;
+	clock Pause;
+	segment_kind LeadKind;
+	uint16_t Lead;			// Segments of LeadKind before the pairs
+	uint16_t Segments;
+	// Cursor
+	uint16_t Entered;		// Segments started so far
+	clock Left;				// Left of the segment in progress
+	uint32_t TotalLeft;		// Seconds left of the session
+} timeline;
+
+void timelineStart(timeline *t, const interval_timer *config);
+segment_kind timelineStep(timeline *t);
+void timelineCount(timeline *t);
+
+segment_kind timelineNext(const timeline *t);
+uint16_t timelineUntilBoundary(const timeline *t);
+uint32_t timelineRemaining(const timeline *t);
+uint8_t timelineRound(const timeline *t);
+uint8_t timelineCompleted(const timeline *t);
+
+#endif /* TIMELINE_H_ */
@@ -0,0 +1,80 @@
+/*
+ * TwiRegisters.c
+ *
+ * See TwiRegisters.h.
+ */
+#include "TwiRegisters.h"
+
+void twiSlaveInit(twi_slave *s) {
+	s->Published = 0;
+	s->Locked = 0;
+	s->SetupWritten = 0;
+	s->Command = TWI_COMMAND_NONE;
+	s->Pointer = 0;
+	s->PointerSet = false;
+}
+
+// Returns the byte to transmit for TWI_STATUS_SLA_R and TWI_STATUS_DATA_TX
+uint8_t twiSlaveEvent(twi_slave *s, uint8_t status, uint8_t data) {
+	uint8_t pointer = s->Pointer;
+
+	switch (status)
+	{
+		case TWI_STATUS_SLA_W:
+			s->PointerSet = false;
+			break;
+		case TWI_STATUS_DATA_RX:
+			if (!s->PointerSet) {
+				s->Pointer = data;
+				s->PointerSet = true;
+				break;
+			}
+			if (pointer == TWI_REG_COMMAND) {
+				s->Command = data;
+			} else if (pointer == TWI_REG_MODE || (pointer >= TWI_REG_WORK_MINUTES && pointer <= TWI_REG_ROUNDS_PAUSE)) {
+				((volatile uint8_t *)&s->Setup)[pointer] = data;
+				s->SetupWritten |= 1U << pointer;
+			}
+			s->Pointer++;
+			break;
+		case TWI_STATUS_SLA_R:
+			s->Locked = s->Published;
+			// Fall through
+		case TWI_STATUS_DATA_TX:
+			s->Pointer++;
+			if (pointer < sizeof(twi_registers)) return ((const uint8_t *)&s->Snapshots[s->Locked])[pointer];
+			break;
+		default:
+			break;
+	}
+	return 0;
+}
+
+// Main loop only. Locked can change under it, but only to Published.
+void twiSlavePublish(twi_slave *s, const twi_registers *registers) {
+	uint8_t next = 0;
+
+	while (next == s->Published || next == s->Locked) next++;
+	s->Snapshots[next] = *registers;
+	// The copy must be complete before the interrupt can see it
+	__asm__ __volatile__ ("" ::: "memory");
+	s->Published = next;
+}
+
+// twiSlaveCommand() and twiSlaveSetup() must not be interrupted by twiSlaveEvent()
+twi_command twiSlaveCommand(twi_slave *s) {
+	twi_command command = s->Command;
+
+	s->Command = TWI_COMMAND_NONE;
+	return command;
+}
+
+// Copies the staged registers and returns a mask of the ones written
+uint16_t twiSlaveSetup(twi_slave *s, twi_registers *setup) {
+	uint16_t written = s->SetupWritten;
+	uint8_t i;
+
+	for (i = 0; i < sizeof(twi_registers); i++) ((uint8_t *)setup)[i] = ((volatile uint8_t *)&s->Setup)[i];
+	s->SetupWritten = 0;
+	return written;
+}
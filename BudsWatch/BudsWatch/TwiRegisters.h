@@ -0,0 +1,95 @@
+/*
+ * TwiRegisters.h
+ *
+ * The register map behind the TWI slave, free of hardware so it also builds
+ * on the host. The interrupt passes each bus event as its TWI status code
+ * and received byte to twiSlaveEvent(), and loads the byte it returns when
+ * transmitting.
+ */
+#ifndef TWIREGISTERS_H_
+#define TWIREGISTERS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "BudsWatch.h"
+
+// Register map, same order as twi_registers
+#define TWI_REG_MODE			0	// r/w
+#define TWI_REG_STATE			1	// r, bit 7 set while paused
+#define TWI_REG_MINUTES			2	// r
+#define TWI_REG_SECONDS			3	// r
+#define TWI_REG_ROUND			4	// r, current work round
+#define TWI_REG_WORK_MINUTES	5	// r/w
+#define TWI_REG_WORK_SECONDS	6	// r/w
+#define TWI_REG_PAUSE_MINUTES	7	// r/w
+#define TWI_REG_PAUSE_SECONDS	8	// r/w
+#define TWI_REG_ROUNDS_WORK		9	// r/w
+#define TWI_REG_ROUNDS_PAUSE	10	// r/w
+#define TWI_REG_COMMAND			11	// w
+#define TWI_REG_NEXT_UP			12	// r, segment_kind after the one in progress
+#define TWI_REG_TOTAL_MINUTES	13	// r, session time left, saturates at 255
+#define TWI_REG_TOTAL_SECONDS	14	// r
+#define TWI_REG_OVERRUNS		15	// r, scheduler task budget overruns
+#define TWI_REG_SLIPS			16	// r, scheduler ticks dispatched late
+#define TWI_REG_COUNT			17
+
+#define TWI_STATE_PAUSED		0x80
+
+/*
+ * Writes to r/w registers are staged and only applied by TWI_COMMAND_START;
+ * reading them returns the configuration in use.
+ */
+typedef enum {
+	TWI_COMMAND_NONE,
+	TWI_COMMAND_START,
+	TWI_COMMAND_PAUSE,	// Toggles pause
+	TWI_COMMAND_RESET	// Back to mode select, aborting a session
+} twi_command;
+
+typedef struct {
+	uint8_t Mode;
+	uint8_t State;
+	uint8_t Minutes;
+	uint8_t Seconds;
+	uint8_t Round;
+	interval_timer Config;
+	uint8_t Command;		// Reads as 0
+	uint8_t NextUp;
+	uint8_t TotalMinutes;
+	uint8_t TotalSeconds;
+	uint8_t Overruns;
+	uint8_t Slips;
+} twi_registers;
+
+// Slave receiver and transmitter status codes, TWSR & 0xF8
+#define TWI_STATUS_BUS_ERROR	0x00
+#define TWI_STATUS_SLA_W		0x60	// Own SLA+W received, ACK returned
+#define TWI_STATUS_DATA_RX		0x80	// Data received, ACK returned
+#define TWI_STATUS_STOP			0xA0	// Stop or repeated start
+#define TWI_STATUS_SLA_R		0xA8	// Own SLA+R received, ACK returned
+#define TWI_STATUS_DATA_TX		0xB8	// Data transmitted, ACK received
+#define TWI_STATUS_DATA_NACK	0xC0	// Data transmitted, NACK received
+
+/*
+ * Triple buffered snapshots: the main loop fills a buffer that is neither
+ * published nor held by a read in progress, then publishes it. Fields
+ * shared with the interrupt are volatile.
+ */
+typedef struct {
+	twi_registers Snapshots[3];
+	volatile uint8_t Published;
+	volatile uint8_t Locked;
+	volatile twi_registers Setup;
+	volatile uint16_t SetupWritten;
+	volatile uint8_t Command;
+	uint8_t Pointer;
+	bool PointerSet;
+} twi_slave;
+
+void twiSlaveInit(twi_slave *s);
+uint8_t twiSlaveEvent(twi_slave *s, uint8_t status, uint8_t data);
+void twiSlavePublish(twi_slave *s, const twi_registers *registers);
+twi_command twiSlaveCommand(twi_slave *s);
+uint16_t twiSlaveSetup(twi_slave *s, twi_registers *setup);
+
+#endif /* TWIREGISTERS_H_ */
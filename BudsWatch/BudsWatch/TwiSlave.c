@@ -0,0 +1,54 @@
+/*
+ * TwiSlave.c
+ *
+ * See TwiSlave.h. The registers themselves live in TwiRegisters.c.
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "TwiSlave.h"
+
+#define TWI_ACK		((1 << TWINT) | (1 << TWEA) | (1 << TWEN) | (1 << TWIE))
+
+static twi_slave Slave;
+
+void twiInit(void) {
+	twiSlaveInit(&Slave);
+	TWAR = TWI_ADDRESS << 1;
+	TWCR = TWI_ACK;
+}
+
+void twiPublish(const twi_registers *registers) {
+	twiSlavePublish(&Slave, registers);
+}
+
+twi_command twiCommand(void) {
+	twi_command command;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		command = twiSlaveCommand(&Slave);
+	}
+	return command;
+}
+
+uint16_t twiSetup(twi_registers *setup) {
+	uint16_t written;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		written = twiSlaveSetup(&Slave, setup);
+	}
+	return written;
+}
+
+ISR(TWI_vect) {
+	uint8_t status = TWSR & 0xF8;
+	uint8_t data;
+
+	if (status == TWI_STATUS_BUS_ERROR) {
+		TWCR = TWI_ACK | (1 << TWSTO);
+		return;
+	}
+	data = twiSlaveEvent(&Slave, status, TWDR);
+	if (status == TWI_STATUS_SLA_R || status == TWI_STATUS_DATA_TX) TWDR = data;
+	TWCR = TWI_ACK;
+}
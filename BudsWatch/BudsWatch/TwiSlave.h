@@ -0,0 +1,26 @@
+/*
+ * TwiSlave.h
+ *
+ * Interrupt driven TWI (I2C) slave exposing a register map to a host
+ * controller. A transaction starts with the register pointer and then reads
+ * or writes consecutive registers. Reads are served from the snapshot that
+ * was current when the read started, so a transaction never mixes values
+ * from two seconds.
+ *
+ * SCL/SDA share PC0/PC1 with KEY0/KEY1, so the keys move to PD4..PD7 when
+ * TWI_SLAVE is defined.
+ */
+#ifndef TWISLAVE_H_
+#define TWISLAVE_H_
+
+#include <stdint.h>
+#include "TwiRegisters.h"
+
+#define TWI_ADDRESS				0x42
+
+void twiInit(void);
+void twiPublish(const twi_registers *registers);
+twi_command twiCommand(void);
+uint16_t twiSetup(twi_registers *setup);
+
+#endif /* TWISLAVE_H_ */
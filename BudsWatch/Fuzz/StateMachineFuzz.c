@@ -0,0 +1,196 @@
+/*
+ * StateMachineFuzz.c
+ *
+ * Host harness for the mode state machine. Each input byte is one or more
+ * machineStep() calls, and the invariants are checked after every step:
+ *   - shown digits are in the font, and the mode and states are in range
+ *   - configured and remaining rounds never wrap below 0 (or above 99)
+ *   - a started interval session finishes within its timeline + 1 ticks
+ *
+ * Byte encoding:
+ *   0x00-0x7F  (b + 1) ticks with no keys
+ *   0x80-0xBF  keys b & 0x0F, tick if b & 0x10, abort if b & 0x20
+ *   0xC0-0xFF  command b & 0x03, COMMAND_START reads 8 more bytes:
+ *              written mask, mode, then the interval_timer fields
+ *
+ * Standalone, random streams biased towards ticks:
+ *   cc -O2 -I../BudsWatch StateMachineFuzz.c ../BudsWatch/StateMachine.c ../BudsWatch/Timeline.c -lm
+ *   ./a.out [steps] [seed]
+ *
+ * libFuzzer:
+ *   clang -O2 -g -fsanitize=fuzzer,address,undefined -DFUZZ_LIBFUZZER -I../BudsWatch \
+ *     StateMachineFuzz.c ../BudsWatch/StateMachine.c ../BudsWatch/Timeline.c -lm
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <sys/time.h>	// Not time.h, whose clock() clashes with the clock type
+#include "StateMachine.h"
+
+#define FUZZ_SETUP_BYTES	(2 + SETUP_CONFIG_FIELDS)
+
+typedef struct {
+	state_machine Machine;
+	bool Tracking;			// Interval session running
+	uint32_t Bound;			// Running seconds it may take to finish
+	unsigned long long Steps;
+	unsigned long long Sessions;
+} fuzz_context;
+
+static void fuzzFail(const fuzz_context *f, const char *what) {
+	const state_machine *m = &f->Machine;
+
+	fprintf(stderr, "invariant failed after %llu steps: %s\n", f->Steps, what);
+	fprintf(stderr, "  state %d mode %d conf %d paused %d work %u:%02u pause %u:%02u rounds %u/%u\n",
+		m->State, m->Mode, m->intervalConfiguration, m->Paused,
+		m->intervalState.Work.Minutes, m->intervalState.Work.Seconds,
+		m->intervalState.Pause.Minutes, m->intervalState.Pause.Seconds,
+		m->intervalState.RoundsWork, m->intervalState.RoundsPause);
+	abort();
+}
+
+static void fuzzCheck(fuzz_context *f, state before, const machine_output *out) {
+	const state_machine *m = &f->Machine;
+	uint8_t digit;
+
+	if (m->Mode < MODE_STOPWATCH || m->Mode > MODE_LAST) fuzzFail(f, "mode out of range");
+	if (m->State > STATE_FINISHED) fuzzFail(f, "state out of range");
+	if (m->intervalConfiguration > CONF_LAST) fuzzFail(f, "configuration step out of range");
+	for (digit = 0; digit < DISPLAY_DIGITS; digit++) {
+		if ((m->Display.showdigits & (1 << digit)) && m->Display.digits[digit] > DIGIT_S) fuzzFail(f, "digit out of range");
+	}
+	if (m->intervalState.RoundsWork > 99 || m->intervalState.RoundsPause > 99) fuzzFail(f, "rounds wrapped");
+	if (m->Minutes > 99 || m->Seconds > 99) fuzzFail(f, "configure value out of range");
+	if (out->Ended != SESSION_RUNNING && before != STATE_RUNNING) fuzzFail(f, "session ended outside running");
+	if (out->Ended != SESSION_RUNNING && out->Completed > m->sessionState.RoundsWork) fuzzFail(f, "more rounds completed than configured");
+	if (out->Phase != SEGMENT_NONE && before != STATE_RUNNING) fuzzFail(f, "phase change outside running");
+	if ((out->Phase == SEGMENT_END) != (out->Ended == SESSION_FINISHED)) fuzzFail(f, "phase end and session end disagree");
+	if (m->State == STATE_RUNNING && (m->Display.dots & (DOT_WORK | DOT_REST)) == (DOT_WORK | DOT_REST)) fuzzFail(f, "work and rest shown at once");
+	if (m->Display.dots & (1 << (DISPLAY_DIGITS - 1))) fuzzFail(f, "dot of the low battery warning used");
+
+	// Termination, counted in seconds the session actually ran
+	if (before != STATE_RUNNING && m->State == STATE_RUNNING && m->Interval) {
+		f->Tracking = true;
+		f->Bound = timelineRemaining(&m->Timeline) + 1;
+		f->Sessions++;
+	}
+	if (f->Tracking) {
+		if (m->State != STATE_RUNNING) {
+			if (m->State == STATE_FINISHED && out->Ended != SESSION_FINISHED) fuzzFail(f, "finished without ending the session");
+			f->Tracking = false;
+		} else if (m->SessionSeconds >= f->Bound) {
+			fuzzFail(f, "session did not terminate");
+		}
+	}
+}
+
+static void fuzzStep(fuzz_context *f, const machine_input *in) {
+	state before = f->Machine.State;
+	machine_output out;
+
+	machineStep(&f->Machine, in, &out);
+	f->Steps++;
+	fuzzCheck(f, before, &out);
+}
+
+static void fuzzRun(fuzz_context *f, const uint8_t *data, size_t size) {
+	size_t i = 0;
+
+	while (i < size) {
+		uint8_t b = data[i++];
+		machine_input in = { 0 };
+
+		if (b < 0x80) {
+			uint8_t n;
+
+			in.Tick = true;
+			for (n = 0; n <= b; n++) fuzzStep(f, &in);
+			continue;
+		}
+		if (b < 0xC0) {
+			in.Presses = b & 0x0F;
+			in.Tick = (b & 0x10) != 0;
+			in.Abort = (b & 0x20) != 0;
+		} else {
+			in.Command = b & 0x03;
+			if (in.Command == COMMAND_START) {
+				if (size - i < FUZZ_SETUP_BYTES) return;
+				in.Setup.Written = data[i++];
+				in.Setup.Mode = data[i++];
+				in.Setup.Config.Work.Minutes = data[i++];
+				in.Setup.Config.Work.Seconds = data[i++];
+				in.Setup.Config.Pause.Minutes = data[i++];
+				in.Setup.Config.Pause.Seconds = data[i++];
+				in.Setup.Config.RoundsWork = data[i++];
+				in.Setup.Config.RoundsPause = data[i++];
+			}
+		}
+		fuzzStep(f, &in);
+	}
+}
+
+#ifdef FUZZ_LIBFUZZER
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	fuzz_context f = { 0 };
+
+	machineInit(&f.Machine);
+	fuzzRun(&f, data, size);
+	return 0;
+}
+#else
+static uint32_t RandomState;
+
+static uint32_t fuzzRandom(void) {
+	RandomState ^= RandomState << 13;
+	RandomState ^= RandomState >> 17;
+	RandomState ^= RandomState << 5;
+	return RandomState;
+}
+
+// Mostly ticks, so sessions get far enough to finish, with keys and commands between
+static void fuzzFill(uint8_t *data, size_t size) {
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		uint32_t r = fuzzRandom();
+
+		switch (r % 16) {
+			case 0: case 1: case 2: case 3: case 4:
+				data[i] = 0x80 | (r >> 8 & 0x1F);						// Keys, no abort
+				break;
+			case 5:
+				data[i] = r % 64 == 5 ? 0xA0 : 0xC0 | (r >> 8 & 0x03);	// Abort or command
+				break;
+			case 6:
+				data[i] = 0x80 | (r >> 8 & 0x07);						// Configure keys
+				break;
+			default:
+				data[i] = r >> 8 & 0x7F;								// Ticks
+				break;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	unsigned long long steps = argc > 1 ? strtoull(argv[1], NULL, 0) : 100000000ULL;
+	uint8_t data[4096];
+	fuzz_context f = { 0 };
+	struct timeval started, stopped;
+	double elapsed;
+
+	RandomState = argc > 2 ? strtoul(argv[2], NULL, 0) : 0x2545F491;
+	if (RandomState == 0) RandomState = 1;
+	printf("seed %lu\n", (unsigned long)RandomState);
+
+	machineInit(&f.Machine);
+	gettimeofday(&started, NULL);
+	while (f.Steps < steps) {
+		fuzzFill(data, sizeof(data));
+		fuzzRun(&f, data, sizeof(data));
+	}
+	gettimeofday(&stopped, NULL);
+	elapsed = (stopped.tv_sec - started.tv_sec) + (stopped.tv_usec - started.tv_usec) / 1e6;
+	printf("%llu steps, %llu interval sessions, %.0f steps/s\n", f.Steps, f.Sessions, elapsed > 0 ? f.Steps / elapsed : 0);
+	return 0;
+}
+#endif
@@ -0,0 +1,190 @@
+/*
+ * TwiSlaveSim.c
+ *
+ * Host stand-in for an I2C master, driving the TWI register map with the
+ * status codes the slave hardware would report for each bus event. Covers
+ * register pointer writes, staged setup, commands, reads that span several
+ * publishes, and reads past the end of the map.
+ *
+ *   cc -O2 -I../BudsWatch TwiSlaveSim.c ../BudsWatch/TwiRegisters.c
+ *   ./a.out
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "TwiRegisters.h"
+
+static twi_slave Slave;
+static unsigned Checks = 0;
+static unsigned Failures = 0;
+
+#define CHECK(condition) simCheck((condition), #condition, __LINE__)
+
+static void simCheck(bool ok, const char *what, int line) {
+	Checks++;
+	if (!ok) {
+		Failures++;
+		fprintf(stderr, "line %d: %s\n", line, what);
+	}
+}
+
+// START, SLA+W, pointer, data..., STOP
+static void masterWrite(uint8_t pointer, const uint8_t *data, uint8_t length) {
+	uint8_t i;
+
+	twiSlaveEvent(&Slave, TWI_STATUS_SLA_W, 0);
+	twiSlaveEvent(&Slave, TWI_STATUS_DATA_RX, pointer);
+	for (i = 0; i < length; i++) twiSlaveEvent(&Slave, TWI_STATUS_DATA_RX, data[i]);
+	twiSlaveEvent(&Slave, TWI_STATUS_STOP, 0);
+}
+
+// START, SLA+W, pointer, repeated START, SLA+R: the first byte
+static uint8_t masterReadStart(uint8_t pointer) {
+	twiSlaveEvent(&Slave, TWI_STATUS_SLA_W, 0);
+	twiSlaveEvent(&Slave, TWI_STATUS_DATA_RX, pointer);
+	twiSlaveEvent(&Slave, TWI_STATUS_STOP, 0);
+	return twiSlaveEvent(&Slave, TWI_STATUS_SLA_R, 0);
+}
+
+// ACK of the previous byte: the next one
+static uint8_t masterReadNext(void) {
+	return twiSlaveEvent(&Slave, TWI_STATUS_DATA_TX, 0);
+}
+
+// NACK of the last byte, STOP
+static void masterReadEnd(void) {
+	twiSlaveEvent(&Slave, TWI_STATUS_DATA_NACK, 0);
+	twiSlaveEvent(&Slave, TWI_STATUS_STOP, 0);
+}
+
+static void masterRead(uint8_t pointer, uint8_t *data, uint8_t length) {
+	uint8_t i;
+
+	data[0] = masterReadStart(pointer);
+	for (i = 1; i < length; i++) data[i] = masterReadNext();
+	masterReadEnd();
+}
+
+// Every register holds the generation, so a mixed read shows up
+static void publishGeneration(uint8_t generation) {
+	twi_registers registers;
+
+	memset(&registers, generation, sizeof(registers));
+	twiSlavePublish(&Slave, &registers);
+}
+
+static void testSetup(void) {
+	const uint8_t config[] = { 2, 30, 0, 45, 12, 11 };
+	const uint8_t readOnly[] = { 7, 8, 9, 10, 33 };
+	uint8_t mode = MODE_INTERVAL;
+	twi_registers setup;
+	uint16_t written;
+
+	twiSlaveInit(&Slave);
+	masterWrite(TWI_REG_MODE, &mode, 1);
+	masterWrite(TWI_REG_WORK_MINUTES, config, sizeof(config));
+	written = twiSlaveSetup(&Slave, &setup);
+	CHECK(written == ((1U << TWI_REG_MODE) | (0x3FU << TWI_REG_WORK_MINUTES)));
+	CHECK(setup.Mode == MODE_INTERVAL);
+	CHECK(memcmp(&setup.Config, config, sizeof(config)) == 0);
+	CHECK(twiSlaveCommand(&Slave) == TWI_COMMAND_NONE);
+
+	// Read only registers are skipped, but still advance the pointer
+	masterWrite(TWI_REG_STATE, readOnly, sizeof(readOnly));
+	written = twiSlaveSetup(&Slave, &setup);
+	CHECK(written == (1U << TWI_REG_WORK_MINUTES));
+	CHECK(setup.Config.Work.Minutes == 33);
+
+	// Consumed by the first twiSlaveSetup()
+	CHECK(twiSlaveSetup(&Slave, &setup) == 0);
+}
+
+static void testCommands(void) {
+	const uint8_t startLast[] = { 4, TWI_COMMAND_START };
+	const uint8_t pastEnd[] = { 1, 2, 3, 4, 5, 6 };
+	uint8_t command = TWI_COMMAND_PAUSE;
+	twi_registers setup;
+
+	twiSlaveInit(&Slave);
+	masterWrite(TWI_REG_COMMAND, &command, 1);
+	CHECK(twiSlaveCommand(&Slave) == TWI_COMMAND_PAUSE);
+	CHECK(twiSlaveCommand(&Slave) == TWI_COMMAND_NONE);
+
+	// Auto-increment runs from the last setup register into COMMAND
+	masterWrite(TWI_REG_ROUNDS_PAUSE, startLast, sizeof(startLast));
+	CHECK(twiSlaveCommand(&Slave) == TWI_COMMAND_START);
+	CHECK(twiSlaveSetup(&Slave, &setup) == (1U << TWI_REG_ROUNDS_PAUSE));
+	CHECK(setup.Config.RoundsPause == 4);
+
+	// Writes past the command register, and past the map, change nothing
+	masterWrite(TWI_REG_NEXT_UP, pastEnd, sizeof(pastEnd));
+	masterWrite(250, pastEnd, sizeof(pastEnd));
+	CHECK(twiSlaveCommand(&Slave) == TWI_COMMAND_NONE);
+	CHECK(twiSlaveSetup(&Slave, &setup) == 0);
+}
+
+static void testReads(void) {
+	uint8_t data[TWI_REG_COUNT + 4];
+	uint8_t i;
+	bool same = true;
+
+	twiSlaveInit(&Slave);
+	publishGeneration(1);
+	masterRead(0, data, TWI_REG_COUNT + 4);
+	for (i = 0; i < TWI_REG_COUNT; i++) CHECK(data[i] == 1);
+	for (i = TWI_REG_COUNT; i < TWI_REG_COUNT + 4; i++) CHECK(data[i] == 0);
+
+	masterRead(TWI_REG_SECONDS, data, 2);
+	CHECK(data[0] == 1 && data[1] == 1);
+
+	// Publishes while a read is in progress do not reach it
+	publishGeneration(2);
+	data[0] = masterReadStart(0);
+	for (i = 1; i < TWI_REG_COUNT; i++) {
+		publishGeneration(2 + i);
+		data[i] = masterReadNext();
+		if (data[i] != 2) same = false;
+	}
+	masterReadEnd();
+	CHECK(same);
+
+	// The next read sees the latest
+	masterRead(TWI_REG_MODE, data, 1);
+	CHECK(data[0] == 2 + TWI_REG_COUNT - 1);
+}
+
+static void testInterleaved(void) {
+	uint8_t generation = 0;
+	unsigned round;
+	uint8_t i, n;
+	bool same = true, fresh = true;
+
+	// Publishes between every byte of reads of random length and start
+	twiSlaveInit(&Slave);
+	srand(1);
+	for (round = 0; round < 100000; round++) {
+		uint8_t start = rand() % TWI_REG_COUNT;
+		uint8_t length = 1 + rand() % (TWI_REG_COUNT - start);
+		uint8_t first;
+
+		publishGeneration(++generation);
+		first = masterReadStart(start);
+		if (first != generation) fresh = false;
+		for (i = 1; i < length; i++) {
+			for (n = rand() % 3; n > 0; n--) publishGeneration(++generation);
+			if (masterReadNext() != first) same = false;
+		}
+		masterReadEnd();
+	}
+	CHECK(fresh);
+	CHECK(same);
+}
+
+int main(void) {
+	testSetup();
+	testCommands();
+	testReads();
+	testInterleaved();
+	printf("%u checks, %u failed\n", Checks, Failures);
+	return Failures > 0;
+}
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+#
+# SizeReport.py
+#
+# Per-function flash and RAM use of the firmware, read from the GNU ld map
+# file. Needs -ffunction-sections -fdata-sections so every function and
+# variable has its own input section; code from libraries without them
+# (libgcc, libm's floor and soft-float) is listed by object file instead.
+#
+# Entries are rolled up by subsystem using the module prefix of the name
+# (historyAppend and HistoryRecord both count towards "history").
+#
+#   SizeReport.py build/size/BudsWatch.map
+#   SizeReport.py build/size/BudsWatch.map --history SizeHistory.csv --variant size --revision abc123
+#
+import argparse
+import csv
+import datetime
+import os
+import re
+import sys
+
+# ATmega16
+FLASH_SIZE = 16384
+RAM_SIZE = 1024
+EEPROM_SIZE = 512
+
+# Output sections and the memories they take up
+OUTPUT_SECTIONS = {
+	'.text': ('flash',),
+	'.data': ('flash', 'ram'),	# Initial values are copied from flash
+	'.bss': ('ram',),
+	'.noinit': ('ram',),
+	'.eeprom': ('eeprom',),
+}
+
+INPUT_PREFIXES = ('.progmem.gcc_sw_table.', '.progmem.data.', '.progmem.', '.rodata.', '.text.startup.', '.text.unlikely.', '.text.hot.', '.text.', '.data.', '.bss.', '.noinit.')
+COMPILER_SUFFIX = re.compile(r'\.(lto_priv|constprop|isra|part|cold)\.?\d*$')
+INPUT_SECTION = re.compile(r'^ (\.\S+|COMMON)(?:\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(.+))?$')
+CONTINUATION = re.compile(r'^\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(.+)$')
+ARCHIVE_MEMBER = re.compile(r'([^/\\]+)\(([^)]+)\)$')
+
+
+def objectName(path):
+	member = ARCHIVE_MEMBER.search(path)
+	if member:
+		return '%s(%s)' % (member.group(1), member.group(2))
+	return os.path.basename(path)
+
+
+def entryName(section, path):
+	# Library sections name the library (.text.fplib, .text.avr-libc), not the function
+	if ARCHIVE_MEMBER.search(path):
+		return objectName(path)
+	for prefix in INPUT_PREFIXES:
+		if section.startswith(prefix):
+			return section[len(prefix):]
+	return objectName(path)
+
+
+def subsystem(name):
+	name = COMPILER_SUFFIX.sub('', name)
+	if name.startswith('__vector_'):
+		return 'interrupts'
+	if '(' in name or name.endswith('.o'):
+		return 'library'
+	if name.startswith('_'):
+		return 'runtime'
+	match = re.match(r'[A-Za-z][a-z0-9]*', name)
+	return match.group(0).lower() if match else name
+
+
+def parseMap(path):
+	entries = {}
+	memory = None
+	pending = None
+	inMap = False
+
+	with open(path) as mapFile:
+		for line in mapFile:
+			line = line.rstrip('\r\n')
+			if line.startswith('Linker script and memory map'):
+				inMap = True
+				continue
+			if not inMap or not line:
+				continue
+
+			if not line[0].isspace():
+				# Output section, or the end of the allocated ones
+				name = line.split()[0]
+				memory = OUTPUT_SECTIONS.get(name)
+				pending = None
+				continue
+			if memory is None:
+				continue
+
+			if pending is not None:
+				match = CONTINUATION.match(line)
+				if match:
+					addSection(entries, memory, pending, int(match.group(2), 16), match.group(3))
+				pending = None
+				continue
+
+			match = INPUT_SECTION.match(line)
+			if not match:
+				continue
+			if match.group(2) is None:
+				pending = match.group(1)	# Long name, address and size follow
+			else:
+				addSection(entries, memory, match.group(1), int(match.group(3), 16), match.group(4))
+	return entries
+
+
+def addSection(entries, memory, section, size, path):
+	if size == 0:
+		return
+	name = entryName(section, path.strip())
+	entry = entries.setdefault(name, {'flash': 0, 'ram': 0, 'eeprom': 0})
+	for kind in memory:
+		entry[kind] += size
+
+
+def percent(used, total):
+	return '%5.1f%%' % (100.0 * used / total)
+
+
+def report(entries, out):
+	totals = {'flash': 0, 'ram': 0, 'eeprom': 0}
+	groups = {}
+
+	for name, entry in entries.items():
+		group = groups.setdefault(subsystem(name), {'flash': 0, 'ram': 0, 'eeprom': 0})
+		for kind in totals:
+			totals[kind] += entry[kind]
+			group[kind] += entry[kind]
+
+	out.write('%7s %6s  %s\n' % ('flash', 'ram', 'function / variable'))
+	for name, entry in sorted(entries.items(), key=lambda item: (-item[1]['flash'], -item[1]['ram'], item[0])):
+		if entry['flash'] or entry['ram']:
+			out.write('%7d %6d  %s\n' % (entry['flash'], entry['ram'], name))
+
+	out.write('\n%7s %6s  %s\n' % ('flash', 'ram', 'subsystem'))
+	for name, group in sorted(groups.items(), key=lambda item: (-item[1]['flash'], -item[1]['ram'], item[0])):
+		if group['flash'] or group['ram']:
+			out.write('%7d %6d  %s\n' % (group['flash'], group['ram'], name))
+
+	out.write('\nflash  %6d of %6d %s\n' % (totals['flash'], FLASH_SIZE, percent(totals['flash'], FLASH_SIZE)))
+	out.write('ram    %6d of %6d %s  (static only, the stack comes on top)\n' % (totals['ram'], RAM_SIZE, percent(totals['ram'], RAM_SIZE)))
+	out.write('eeprom %6d of %6d %s\n' % (totals['eeprom'], EEPROM_SIZE, percent(totals['eeprom'], EEPROM_SIZE)))
+	return totals, groups
+
+
+def appendHistory(path, variant, revision, totals, groups):
+	# One row per build: totals, then the subsystems so their growth can be followed
+	newFile = not os.path.exists(path)
+	with open(path, 'a', newline='') as historyFile:
+		writer = csv.writer(historyFile)
+		if newFile:
+			writer.writerow(['date', 'revision', 'variant', 'flash', 'ram', 'eeprom', 'subsystems'])
+		writer.writerow([
+			datetime.date.today().isoformat(), revision, variant,
+			totals['flash'], totals['ram'], totals['eeprom'],
+			' '.join('%s=%d' % (name, group['flash']) for name, group in sorted(groups.items()) if group['flash']),
+		])
+
+
+def main():
+	parser = argparse.ArgumentParser(description='Per-function flash/RAM report from an avr-gcc map file')
+	parser.add_argument('map', help='map file written with -Wl,-Map')
+	parser.add_argument('--history', help='CSV file to append the totals to')
+	parser.add_argument('--variant', default='', help='build variant, for the history')
+	parser.add_argument('--revision', default='', help='source revision, for the history')
+	args = parser.parse_args()
+
+	entries = parseMap(args.map)
+	if not entries:
+		sys.exit('%s: no allocated sections found' % args.map)
+	totals, groups = report(entries, sys.stdout)
+	if args.history:
+		appendHistory(args.history, args.variant, args.revision, totals, groups)
+
+
+if __name__ == '__main__':
+	main()